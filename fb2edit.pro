@@ -1,16 +1,22 @@
 HEADERS = \
     source/fb2html.h \
     source/fb2app.hpp \
+    source/fb2batch.h \
     source/fb2code.hpp \
+    source/fb2highlight.h \
     source/fb2dlgs.hpp \
     source/fb2dock.hpp \
+    source/fb2find.hpp \
     source/fb2head.hpp \
     source/fb2imgs.hpp \
     source/fb2list.hpp \
     source/fb2main.hpp \
+    source/fb2memo.hpp \
+    source/fb2norm.hpp \
     source/fb2note.hpp \
     source/fb2page.hpp \
     source/fb2read.hpp \
+    source/fb2trace.h \
     source/fb2tree.hpp \
     source/fb2save.hpp \
     source/fb2text.hpp \
@@ -22,18 +28,24 @@ HEADERS = \
 
 SOURCES = \
     source/fb2app.cpp \
+    source/fb2batch.cpp \
     source/fb2code.cpp \
+    source/fb2highlight.cpp \
     source/fb2dlgs.cpp \
     source/fb2dock.cpp \
+    source/fb2find.cpp \
     source/fb2head.cpp \
     source/fb2html.cpp \
     source/fb2imgs.cpp \
     source/fb2list.cpp \
     source/fb2main.cpp \
+    source/fb2memo.cpp \
+    source/fb2norm.cpp \
     source/fb2note.cpp \
     source/fb2page.cpp \
     source/fb2read.cpp \
     source/fb2save.cpp \
+    source/fb2trace.cpp \
     source/fb2tree.cpp \
     source/fb2xml.cpp \
     source/fb2xml2.cpp \
@@ -62,13 +74,17 @@ OTHER_FILES += \
     source/res/blank.fb2 \
     source/js/export.js \
     source/js/set_cursor.js \
-    source/js/get_status.js \
     source/js/insert_title.js \
     CMakeLists.txt \
     source/js/new_section1.js \
     source/js/section_get.js \
-    source/js/section_new.js \
     source/js/location.js \
+    source/js/fix_contents.js \
+    source/js/notes.js \
+    source/js/replace.js \
+    source/js/undo.js \
+    source/js/virtual.js \
+    source/js/check.js \
     source/res/mainicon.rc \
     3rdparty/fb2/FictionBookLinks.xsd \
     3rdparty/fb2/FictionBookLang.xsd \
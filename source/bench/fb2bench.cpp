@@ -0,0 +1,374 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QStringList>
+#include <QTextDocument>
+#include <QTextStream>
+#include <QWebFrame>
+#include <QXmlDefaultHandler>
+#include <QXmlSchema>
+#include <QXmlSchemaValidator>
+#include <QtAlgorithms>
+
+#include "fb2corpus.h"
+#include "fb2highlight.h"
+#include "fb2imgs.hpp"
+#include "fb2page.hpp"
+#include "fb2read.hpp"
+#include "fb2text.hpp"
+#include "fb2tree.hpp"
+#include "fb2utils.h"
+#include "fb2xml2.h"
+
+//---------------------------------------------------------------------------
+//  Statistics
+//---------------------------------------------------------------------------
+
+class FbBenchResult
+{
+public:
+    explicit FbBenchResult(const QString &name, qint64 size) : m_name(name), m_size(size) {}
+    void append(qint64 nsecs) { m_times << nsecs / 1e6; }
+    QString toJson() const;
+private:
+    double percentile(const QList<double> &sorted, double p) const;
+private:
+    QString m_name;
+    qint64 m_size;
+    QList<double> m_times;
+};
+
+double FbBenchResult::percentile(const QList<double> &sorted, double p) const
+{
+    if (sorted.isEmpty()) return 0;
+    double rank = p * (sorted.count() - 1);
+    int lower = int(rank);
+    int upper = qMin(lower + 1, sorted.count() - 1);
+    return sorted.at(lower) + (sorted.at(upper) - sorted.at(lower)) * (rank - lower);
+}
+
+QString FbBenchResult::toJson() const
+{
+    QList<double> sorted = m_times;
+    qSort(sorted);
+    double median = percentile(sorted, 0.5);
+    double speed = median > 0 ? (m_size / 1048576.0) / (median / 1000.0) : 0;
+
+    QString json;
+    QTextStream out(&json);
+    out << "{\"case\": " << jsString(m_name);
+    out << ", \"bytes\": " << m_size;
+    out << ", \"runs\": " << m_times.count();
+    out << ", \"min\": " << QString::number(sorted.isEmpty() ? 0 : sorted.first(), 'f', 3);
+    out << ", \"median\": " << QString::number(median, 'f', 3);
+    out << ", \"p90\": " << QString::number(percentile(sorted, 0.9), 'f', 3);
+    out << ", \"p99\": " << QString::number(percentile(sorted, 0.99), 'f', 3);
+    out << ", \"max\": " << QString::number(sorted.isEmpty() ? 0 : sorted.last(), 'f', 3);
+    out << ", \"mbps\": " << QString::number(speed, 'f', 2) << "}";
+    out.flush();
+    return json;
+}
+
+//---------------------------------------------------------------------------
+//  Benchmarks
+//---------------------------------------------------------------------------
+
+class FbBench
+{
+public:
+    explicit FbBench(const QStringList &cases, int runs, quint32 seed) : m_cases(cases), m_runs(runs), m_seed(seed), m_valid(true) {}
+    void run(qint64 size);
+    QString toJson() const;
+    bool valid() const { return m_valid; }
+private:
+    bool enabled(const QString &name) const { return m_cases.isEmpty() || m_cases.contains(name); }
+    void benchParse(const QByteArray &xml);
+    void benchValidate(const QByteArray &xml);
+    void benchRead(const QByteArray &xml, QString &html);
+    void benchBase64(const QByteArray &xml);
+    void benchStore(const QByteArray &xml, const QStringList &names, FbStore &store);
+    void benchPage(const QByteArray &xml, const QString &html);
+    void benchHighlight(const QByteArray &xml);
+    static void waitLoaded(FbTextEdit &edit, const QString &html, FbStore *store);
+private:
+    const QStringList m_cases;
+    const int m_runs;
+    const quint32 m_seed;
+    QList<FbBenchResult> m_results;
+    bool m_valid;
+};
+
+void FbBench::run(qint64 size)
+{
+    QTextStream(stderr) << "corpus: " << size << " bytes" << endl;
+    FbCorpus::Options options;
+    options.seed = m_seed;
+    options.size = size;
+    options.notes = 10 + size / 16384;
+    options.binaries = 1 + size / 524288;
+    const QByteArray xml = FbCorpus(options).toByteArray();
+
+    QString html;
+    benchParse(xml);
+    benchValidate(xml);
+    benchRead(xml, html);
+    benchBase64(xml);
+    benchPage(xml, html);
+    benchHighlight(xml);
+}
+
+void FbBench::benchParse(const QByteArray &xml)
+{
+    if (!enabled("parse")) return;
+    FbBenchResult result("parse", xml.size());
+    for (int i = 0; i < m_runs; ++i) {
+        QXmlDefaultHandler handler;
+#ifdef FB2_USE_LIBXML2
+        XML2::XmlReader reader;
+#else
+        QXmlSimpleReader reader;
+#endif
+        reader.setContentHandler(&handler);
+        QXmlInputSource source;
+        source.setData(xml);
+        QElapsedTimer timer;
+        timer.start();
+        reader.parse(source);
+        result.append(timer.nsecsElapsed());
+    }
+    m_results << result;
+}
+
+// Every corpus must be valid FictionBook 2.1, a failure makes fb2bench exit with 1
+void FbBench::benchValidate(const QByteArray &xml)
+{
+    if (!enabled("validate")) return;
+    QXmlSchema schema;
+    schema.load(QUrl("qrc:/fb2/FictionBook2.1.xsd"));
+    FbBenchResult result("validate", xml.size());
+    for (int i = 0; i < m_runs; ++i) {
+        QXmlSchemaValidator validator(schema);
+        QElapsedTimer timer;
+        timer.start();
+        bool ok = validator.validate(xml);
+        result.append(timer.nsecsElapsed());
+        if (ok) continue;
+        QTextStream(stderr) << "corpus: not valid FictionBook 2.1" << endl;
+        m_valid = false;
+        break;
+    }
+    m_results << result;
+}
+
+void FbBench::benchRead(const QByteArray &xml, QString &html)
+{
+    FbBenchResult result("read", xml.size());
+    int runs = enabled("read") ? m_runs : 1;
+    for (int i = 0; i < runs; ++i) {
+        FbStore store(0);
+        QXmlInputSource source;
+        source.setData(xml);
+        html.clear();
+        QElapsedTimer timer;
+        timer.start();
+        FbReadHandler::load(&store, source, html);
+        result.append(timer.nsecsElapsed());
+    }
+    if (enabled("read")) m_results << result;
+
+    if (!enabled("store")) return;
+    FbStore store(0);
+    QXmlInputSource source;
+    source.setData(xml);
+    QString temp;
+    FbReadHandler::load(&store, source, temp);
+    QStringList names;
+    for (int i = 0; i < store.count(); ++i) names << store.at(i)->name();
+    benchStore(xml, names, store);
+}
+
+void FbBench::benchBase64(const QByteArray &xml)
+{
+    if (enabled("base64-encode")) {
+        FbBenchResult result("base64-encode", xml.size());
+        for (int i = 0; i < m_runs; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            QByteArray data = xml.toBase64();
+            result.append(timer.nsecsElapsed());
+        }
+        m_results << result;
+    }
+
+    if (enabled("base64-decode")) {
+        const QByteArray data = xml.toBase64();
+        FbBenchResult result("base64-decode", data.size());
+        for (int i = 0; i < m_runs; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            QByteArray decoded = QByteArray::fromBase64(data);
+            result.append(timer.nsecsElapsed());
+        }
+        m_results << result;
+    }
+}
+
+void FbBench::benchStore(const QByteArray &xml, const QStringList &names, FbStore &store)
+{
+    if (names.isEmpty()) return;
+    const int lookups = 100000;
+    FbBenchResult result("store", xml.size());
+    for (int i = 0; i < m_runs; ++i) {
+        int found = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int j = 0; j < lookups; ++j) {
+            const QString &name = names.at(j % names.count());
+            if (store.exists(name) && store.get(name)) found++;
+        }
+        result.append(timer.nsecsElapsed());
+        Q_UNUSED(found);
+    }
+    m_results << result;
+}
+
+void FbBench::waitLoaded(FbTextEdit &edit, const QString &html, FbStore *store)
+{
+    QEventLoop loop;
+    QObject::connect(edit.page(), SIGNAL(loadFinished(bool)), &loop, SLOT(quit()));
+    edit.page()->html(html, store);
+    loop.exec();
+}
+
+void FbBench::benchPage(const QByteArray &xml, const QString &html)
+{
+    if (!enabled("load") && !enabled("save") && !enabled("tree")) return;
+    FbBenchResult load("load", xml.size());
+    FbBenchResult save("save", xml.size());
+    FbBenchResult tree("tree", xml.size());
+
+    for (int i = 0; i < m_runs; ++i) {
+        FbTextEdit edit(0, 0);
+        FbStore *store = new FbStore(0);
+        {
+            QXmlInputSource source;
+            source.setData(xml);
+            QString temp;
+            FbReadHandler::load(store, source, temp);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        waitLoaded(edit, html, store);
+        load.append(timer.nsecsElapsed());
+
+        if (enabled("save")) {
+            QByteArray array;
+            timer.start();
+            edit.save(&array);
+            save.append(timer.nsecsElapsed());
+        }
+
+        if (enabled("tree")) {
+            FbTreeModel model(edit);
+            timer.start();
+            model.update();
+            tree.append(timer.nsecsElapsed());
+        }
+    }
+
+    if (enabled("load")) m_results << load;
+    if (enabled("save")) m_results << save;
+    if (enabled("tree")) m_results << tree;
+}
+
+void FbBench::benchHighlight(const QByteArray &xml)
+{
+    if (!enabled("highlight")) return;
+    const QString text = QString::fromUtf8(xml);
+    FbBenchResult result("highlight", xml.size());
+    for (int i = 0; i < m_runs; ++i) {
+        QTextDocument document;
+        document.setPlainText(text);
+        FbHighlighter highlighter((QObject*)0);
+        highlighter.setDocument(&document);
+        QElapsedTimer timer;
+        timer.start();
+        highlighter.rehighlight();
+        result.append(timer.nsecsElapsed());
+    }
+    m_results << result;
+}
+
+QString FbBench::toJson() const
+{
+    QString json;
+    QTextStream out(&json);
+    out << "{\n  \"qt\": " << jsString(qVersion());
+#ifdef FB2_USE_LIBXML2
+    out << ",\n  \"parser\": \"libxml2\"";
+#else
+    out << ",\n  \"parser\": \"qt\"";
+#endif
+    out << ",\n  \"runs\": " << m_runs;
+    out << ",\n  \"seed\": " << m_seed;
+    out << ",\n  \"results\": [";
+    for (int i = 0; i < m_results.count(); ++i) {
+        out << (i ? ",\n    " : "\n    ") << m_results.at(i).toJson();
+    }
+    out << "\n  ]\n}\n";
+    out.flush();
+    return json;
+}
+
+//---------------------------------------------------------------------------
+//  Entry point
+//---------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    Q_INIT_RESOURCE(fb2edit);
+
+    QApplication app(argc, argv);
+    QStringList args = app.arguments();
+
+    QStringList sizes = QString("0.1,1,10,200").split(",");
+    QStringList cases;
+    QString output;
+    int runs = 5;
+    quint32 seed = 1;
+
+    for (int i = 1; i < args.count(); ++i) {
+        const QString &arg = args.at(i);
+        bool last = i + 1 == args.count();
+        if (arg == "--sizes" && !last) {
+            sizes = args.at(++i).split(",", QString::SkipEmptyParts);
+        } else if (arg == "--cases" && !last) {
+            cases = args.at(++i).split(",", QString::SkipEmptyParts);
+        } else if (arg == "--runs" && !last) {
+            runs = qMax(1, args.at(++i).toInt());
+        } else if (arg == "--seed" && !last) {
+            seed = args.at(++i).toUInt();
+        } else if (arg == "--output" && !last) {
+            output = args.at(++i);
+        } else {
+            QTextStream(stderr) << "Usage: fb2bench [--sizes MB,MB,...] [--runs N] [--seed N] [--output FILE]"
+                " [--cases parse,validate,read,load,save,tree,store,base64-encode,base64-decode,highlight]" << endl;
+            return 2;
+        }
+    }
+
+    FbBench bench(cases, runs, seed);
+    foreach (const QString &size, sizes) bench.run(qint64(size.toDouble() * 1048576));
+
+    const QString json = bench.toJson();
+    if (output.isEmpty()) {
+        QTextStream(stdout) << json;
+    } else {
+        QFile file(output);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return 1;
+        file.write(json.toUtf8());
+    }
+    return bench.valid() ? 0 : 1;
+}
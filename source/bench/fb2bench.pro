@@ -0,0 +1,38 @@
+HEADERS = \
+    fb2corpus.h \
+    $$files(../fb2*.hpp) \
+    $$files(../fb2*.h)
+
+SOURCES = \
+    fb2bench.cpp \
+    fb2corpus.cpp \
+    $$files(../fb2*.cpp)
+
+RESOURCES = \
+    ../../3rdparty/gnome/gnome.qrc \
+    ../res/fb2edit.qrc \
+    ../js/javascript.qrc \
+    ../../3rdparty/fb2/fb2.qrc
+
+FORMS += \
+    ../fb2find.ui \
+    ../fb2setup.ui
+
+INCLUDEPATH += ..
+
+DEFINES += FB2_NO_MAIN
+
+QT += xml
+QT += webkit
+QT += network
+QT += xmlpatterns
+
+if (unix) {
+
+    DEFINES += FB2_USE_LIBXML2
+    INCLUDEPATH += /usr/include/libxml2
+    LIBS += -lxml2
+
+}
+
+TARGET = fb2bench
@@ -0,0 +1,379 @@
+#include "fb2corpus.h"
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QStringList>
+#include <QTextCodec>
+
+//---------------------------------------------------------------------------
+//  FbCorpusCounter
+//---------------------------------------------------------------------------
+
+namespace {
+
+// Counts what goes through, pos() is meaningless when writing to a pipe
+class FbCorpusCounter : public QIODevice
+{
+public:
+    explicit FbCorpusCounter(QIODevice *device) : m_device(device), m_written(0) {}
+    qint64 written() const { return m_written; }
+protected:
+    qint64 readData(char *data, qint64 size) { Q_UNUSED(data); Q_UNUSED(size); return -1; }
+    qint64 writeData(const char *data, qint64 size)
+    {
+        qint64 result = m_device->write(data, size);
+        if (result > 0) m_written += result;
+        return result;
+    }
+private:
+    QIODevice *m_device;
+    qint64 m_written;
+};
+
+}
+
+//---------------------------------------------------------------------------
+//  FbCorpus::Options
+//---------------------------------------------------------------------------
+
+FbCorpus::Options::Options()
+    : seed(1)
+    , depth(1)
+    , sections(5)
+    , paragraphs(20)
+    , markup(5)
+    , notes(10)
+    , poems(10)
+    , binaries(2)
+    , binarySize(16384)
+    , size(0)
+    , encoding("UTF-8")
+{
+}
+
+//---------------------------------------------------------------------------
+//  FbCorpus
+//---------------------------------------------------------------------------
+
+FbCorpus::FbCorpus(const Options &options)
+    : m_options(options)
+    , m_state(options.seed ? options.seed : 1)
+    , m_unicode(false)
+    , m_pictures(0)
+    , m_notes(0)
+{
+}
+
+// xorshift32: the same sequence on every platform and Qt version
+quint32 FbCorpus::random()
+{
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+}
+
+int FbCorpus::random(int count)
+{
+    return count > 0 ? random() % count : 0;
+}
+
+bool FbCorpus::chance(int percent)
+{
+    return random(100) < percent;
+}
+
+QString FbCorpus::word()
+{
+    static const QStringList latin = QString(
+        "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor "
+        "incididunt ut labore et dolore magna aliqua enim ad minim veniam quis nostrud "
+        "exercitation ullamco laboris nisi aliquip ex ea commodo consequat duis aute irure "
+        "in reprehenderit voluptate velit esse cillum fugiat nulla pariatur"
+    ).split(" ");
+
+    static const QStringList cyrillic = QString::fromUtf8(
+        "съешь же ещё этих мягких французских булок да выпей чаю широкая электрификация "
+        "южных губерний даст мощный толчок подъёму сельского хозяйства"
+    ).split(" ");
+
+    if (m_unicode && chance(30)) return cyrillic.at(random(cyrillic.count()));
+    return latin.at(random(latin.count()));
+}
+
+void FbCorpus::writeText(int words, bool links)
+{
+    static const char * styles[] = { "strong", "emphasis", "strikethrough", "sub", "sup", "code", "style" };
+
+    for (int i = 0; i < words; ++i) {
+        if (i) m_writer.writeCharacters(" ");
+        if (chance(m_options.markup)) {
+            QString tag = styles[random(7)];
+            m_writer.writeStartElement(tag);
+            if (tag == "style") m_writer.writeAttribute("name", "sample");
+            m_writer.writeCharacters(word());
+            m_writer.writeEndElement();
+        } else {
+            m_writer.writeCharacters(word());
+        }
+        if (links && m_options.notes > 0 && random(1000) < 15) {
+            int note = m_notes++ % m_options.notes + 1;
+            m_writer.writeStartElement("a");
+            m_writer.writeAttribute("l:href", QString("#n%1").arg(note));
+            m_writer.writeAttribute("type", "note");
+            m_writer.writeCharacters(QString("[%1]").arg(note));
+            m_writer.writeEndElement();
+        }
+    }
+}
+
+void FbCorpus::writeParagraph(const QString &tag, bool links)
+{
+    m_writer.writeStartElement(tag);
+    writeText(20 + random(60), links);
+    m_writer.writeEndElement();
+    m_writer.writeCharacters("\n");
+}
+
+void FbCorpus::writeTitle(const QString &text)
+{
+    m_writer.writeStartElement("title");
+    m_writer.writeTextElement("p", text);
+    m_writer.writeEndElement();
+    m_writer.writeCharacters("\n");
+}
+
+void FbCorpus::writePoem()
+{
+    m_writer.writeStartElement("poem");
+    writeTitle(word());
+    int stanzas = 1 + random(4);
+    for (int i = 0; i < stanzas; ++i) {
+        m_writer.writeStartElement("stanza");
+        int lines = 2 + random(6);
+        for (int j = 0; j < lines; ++j) {
+            m_writer.writeStartElement("v");
+            writeText(4 + random(5), false);
+            m_writer.writeEndElement();
+        }
+        m_writer.writeEndElement();
+        m_writer.writeCharacters("\n");
+    }
+    writeParagraph("text-author", false);
+    m_writer.writeEndElement();
+    m_writer.writeCharacters("\n");
+}
+
+void FbCorpus::writeSection(const QString &id, int level)
+{
+    m_writer.writeStartElement("section");
+    m_writer.writeAttribute("id", "s" + id);
+    m_writer.writeCharacters("\n");
+    writeTitle("Chapter " + id);
+
+    if (level < m_options.depth) {
+        for (int i = 1; i <= qMax(1, m_options.sections); ++i) {
+            writeSection(QString("%1.%2").arg(id).arg(i), level + 1);
+        }
+    } else {
+        if (chance(20)) {
+            m_writer.writeStartElement("epigraph");
+            writeParagraph("p", false);
+            writeParagraph("text-author", false);
+            m_writer.writeEndElement();
+            m_writer.writeCharacters("\n");
+        }
+
+        // The schema allows a picture right after the title and epigraphs, or anywhere
+        // after the first block. Pictures alternate between the two places.
+        bool picture = m_pictures < m_options.binaries;
+        bool leading = picture && m_pictures % 2 == 0;
+        if (!leading) writeParagraph();
+        if (picture) {
+            m_writer.writeEmptyElement("image");
+            m_writer.writeAttribute("l:href", QString("#img%1.bmp").arg(++m_pictures));
+            m_writer.writeCharacters("\n");
+        }
+        if (leading) writeParagraph();
+
+        for (int i = 1; i < m_options.paragraphs; ++i) {
+            int kind = random(100);
+            if (kind < 4) {
+                writeParagraph("subtitle");
+            } else if (kind < 8) {
+                m_writer.writeEmptyElement("empty-line");
+                m_writer.writeCharacters("\n");
+            } else if (kind < 10) {
+                m_writer.writeStartElement("cite");
+                writeParagraph();
+                writeParagraph("text-author", false);
+                m_writer.writeEndElement();
+                m_writer.writeCharacters("\n");
+            } else {
+                writeParagraph();
+            }
+        }
+
+        if (chance(m_options.poems)) writePoem();
+    }
+
+    m_writer.writeEndElement();
+    m_writer.writeCharacters("\n");
+}
+
+void FbCorpus::writeDescription()
+{
+    static const char * genres[] = { "prose_classic", "prose_contemporary", "sf", "det_classic", "adventure", "poetry" };
+
+    m_writer.writeStartElement("description");
+    m_writer.writeStartElement("title-info");
+    m_writer.writeTextElement("genre", genres[random(6)]);
+    m_writer.writeStartElement("author");
+    m_writer.writeTextElement("first-name", word());
+    m_writer.writeTextElement("last-name", word());
+    m_writer.writeEndElement();
+    m_writer.writeTextElement("book-title", QString("Sample %1").arg(m_options.seed));
+    m_writer.writeStartElement("annotation");
+    writeParagraph("p", false);
+    m_writer.writeEndElement();
+    m_writer.writeStartElement("date");
+    m_writer.writeAttribute("value", "2013-01-01");
+    m_writer.writeCharacters("2013");
+    m_writer.writeEndElement();
+    if (m_options.binaries > 0) {
+        m_writer.writeStartElement("coverpage");
+        m_writer.writeEmptyElement("image");
+        m_writer.writeAttribute("l:href", "#img1.bmp");
+        m_writer.writeEndElement();
+    }
+    m_writer.writeTextElement("lang", m_unicode ? "ru" : "en");
+    m_writer.writeEndElement();
+
+    m_writer.writeStartElement("document-info");
+    m_writer.writeStartElement("author");
+    m_writer.writeTextElement("nickname", "fb2gen");
+    m_writer.writeEndElement();
+    m_writer.writeTextElement("program-used", "fb2gen");
+    m_writer.writeStartElement("date");
+    m_writer.writeAttribute("value", "2013-01-01");
+    m_writer.writeCharacters("2013");
+    m_writer.writeEndElement();
+    m_writer.writeTextElement("id", QString("fb2gen-%1").arg(m_options.seed));
+    m_writer.writeTextElement("version", "1.0");
+    m_writer.writeEndElement();
+    m_writer.writeEndElement();
+    m_writer.writeCharacters("\n");
+}
+
+void FbCorpus::writeNotes()
+{
+    if (m_options.notes <= 0) return;
+    m_writer.writeStartElement("body");
+    m_writer.writeAttribute("name", "notes");
+    m_writer.writeCharacters("\n");
+    writeTitle("Notes");
+    for (int i = 1; i <= m_options.notes; ++i) {
+        m_writer.writeStartElement("section");
+        m_writer.writeAttribute("id", QString("n%1").arg(i));
+        writeTitle(QString::number(i));
+        writeParagraph("p", false);
+        m_writer.writeEndElement();
+        m_writer.writeCharacters("\n");
+    }
+    m_writer.writeEndElement();
+    m_writer.writeCharacters("\n");
+}
+
+void FbCorpus::writeBinaries()
+{
+    for (int i = 1; i <= m_options.binaries; ++i) {
+        QString data = QString::fromLatin1(picture(i).toBase64());
+        m_writer.writeStartElement("binary");
+        m_writer.writeAttribute("id", QString("img%1.bmp").arg(i));
+        m_writer.writeAttribute("content-type", "image/bmp");
+        m_writer.writeCharacters("\n");
+        for (int pos = 0; pos < data.length(); pos += 76) {
+            m_writer.writeCharacters(data.mid(pos, 76));
+            m_writer.writeCharacters("\n");
+        }
+        m_writer.writeEndElement();
+        m_writer.writeCharacters("\n");
+    }
+}
+
+// An uncompressed 24-bit BMP, so the bytes never depend on an image codec
+QByteArray FbCorpus::picture(int index) const
+{
+    const int width = 64;
+    const int height = qMax(1, m_options.binarySize / (width * 3));
+    const int bytes = width * height * 3;
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << quint8('B') << quint8('M') << quint32(54 + bytes) << quint32(0) << quint32(54);
+    out << quint32(40) << qint32(width) << qint32(height) << quint16(1) << quint16(24);
+    out << quint32(0) << quint32(bytes) << qint32(2835) << qint32(2835) << quint32(0) << quint32(0);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            out << quint8(x * 4 + index * 16) << quint8(y * 4) << quint8((x ^ y) * 4 + index * 32);
+        }
+    }
+    return data;
+}
+
+bool FbCorpus::write(QIODevice *device)
+{
+    QTextCodec *codec = QTextCodec::codecForName(m_options.encoding.toLatin1());
+    if (!codec) return false;
+
+    FbCorpusCounter counter(device);
+    counter.open(QIODevice::WriteOnly);
+    m_writer.setDevice(&counter);
+    m_writer.setCodec(codec);
+    m_unicode = codec->canEncode(QString::fromUtf8("ёж"));
+
+    m_writer.writeStartDocument();
+    m_writer.writeCharacters("\n");
+    m_writer.writeStartElement("FictionBook");
+    m_writer.writeAttribute("xmlns", "http://www.gribuser.ru/xml/fictionbook/2.0");
+    m_writer.writeAttribute("xmlns:l", "http://www.w3.org/1999/xlink");
+    m_writer.writeCharacters("\n");
+
+    writeDescription();
+
+    m_writer.writeStartElement("body");
+    m_writer.writeCharacters("\n");
+    writeTitle(QString("Sample %1").arg(m_options.seed));
+
+    // Pictures and notes are written after the main body, leave room for them
+    const qint64 tail = qint64(m_options.binaries) * (m_options.binarySize * 4 / 3 + 200) + m_options.notes * 600;
+    for (int i = 1; ; ++i) {
+        writeSection(QString::number(i), 0);
+        if (m_options.size > 0) {
+            if (counter.written() + tail >= m_options.size) break;
+        } else if (i >= qMax(1, m_options.sections)) {
+            break;
+        }
+    }
+
+    m_writer.writeEndElement();
+    m_writer.writeCharacters("\n");
+
+    writeNotes();
+    writeBinaries();
+
+    m_writer.writeEndElement();
+    m_writer.writeEndDocument();
+    m_writer.setDevice(0);
+    return true;
+}
+
+QByteArray FbCorpus::toByteArray()
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    write(&buffer);
+    return data;
+}
@@ -0,0 +1,58 @@
+#ifndef FB2CORPUS_H
+#define FB2CORPUS_H
+
+#include <QByteArray>
+#include <QString>
+#include <QXmlStreamWriter>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+class FbCorpus
+{
+public:
+    struct Options {
+        Options();
+        quint32 seed;
+        int depth;       // levels of nested sections below each top-level section
+        int sections;    // child sections per nesting level
+        int paragraphs;  // paragraphs per leaf section
+        int markup;      // percent of words wrapped in inline markup
+        int notes;       // footnotes in the notes body
+        int poems;       // percent of leaf sections that carry a poem
+        int binaries;    // number of embedded pictures
+        int binarySize;  // approximate size of each picture in bytes
+        qint64 size;     // keep adding top-level sections until the output reaches this size
+        QString encoding;
+    };
+
+    explicit FbCorpus(const Options &options);
+    bool write(QIODevice *device);
+    QByteArray toByteArray();
+
+private:
+    quint32 random();
+    int random(int count);
+    bool chance(int percent);
+    QString word();
+    void writeText(int words, bool links);
+    void writeParagraph(const QString &tag = "p", bool links = true);
+    void writeTitle(const QString &text);
+    void writePoem();
+    void writeSection(const QString &id, int level);
+    void writeDescription();
+    void writeNotes();
+    void writeBinaries();
+    QByteArray picture(int index) const;
+
+private:
+    const Options m_options;
+    QXmlStreamWriter m_writer;
+    quint32 m_state;
+    bool m_unicode;
+    int m_pictures;
+    int m_notes;
+};
+
+#endif // FB2CORPUS_H
@@ -0,0 +1,68 @@
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "fb2corpus.h"
+
+static int usage()
+{
+    QTextStream(stderr)
+        << "Usage: fb2gen [options] [--output FILE]\n"
+        << "  --seed N          random seed (1)\n"
+        << "  --depth N         nested section levels (1)\n"
+        << "  --sections N      sections per level (5)\n"
+        << "  --paragraphs N    paragraphs per leaf section (20)\n"
+        << "  --markup PCT      words with inline markup (5)\n"
+        << "  --notes N         footnotes (10)\n"
+        << "  --poems PCT       leaf sections with a poem (10)\n"
+        << "  --binaries N      embedded pictures (2)\n"
+        << "  --binary-size N   bytes per picture (16384)\n"
+        << "  --size MB         grow the book to about this size\n"
+        << "  --encoding NAME   output encoding (UTF-8)\n";
+    return 2;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+
+    FbCorpus::Options options;
+    QString output;
+
+    for (int i = 1; i < args.count(); ++i) {
+        const QString &arg = args.at(i);
+        if (i + 1 == args.count()) return usage();
+        const QString value = args.at(++i);
+        if (arg == "--seed") options.seed = value.toUInt();
+        else if (arg == "--depth") options.depth = value.toInt();
+        else if (arg == "--sections") options.sections = value.toInt();
+        else if (arg == "--paragraphs") options.paragraphs = value.toInt();
+        else if (arg == "--markup") options.markup = value.toInt();
+        else if (arg == "--notes") options.notes = value.toInt();
+        else if (arg == "--poems") options.poems = value.toInt();
+        else if (arg == "--binaries") options.binaries = value.toInt();
+        else if (arg == "--binary-size") options.binarySize = value.toInt();
+        else if (arg == "--size") options.size = qint64(value.toDouble() * 1048576);
+        else if (arg == "--encoding") options.encoding = value;
+        else if (arg == "--output") output = value;
+        else return usage();
+    }
+
+    QFile file;
+    bool ok = output.isEmpty()
+        ? file.open(stdout, QIODevice::WriteOnly)
+        : (file.setFileName(output), file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    if (!ok) {
+        QTextStream(stderr) << "Cannot write " << output << "\n";
+        return 1;
+    }
+
+    FbCorpus corpus(options);
+    if (!corpus.write(&file)) {
+        QTextStream(stderr) << "Unknown encoding " << options.encoding << "\n";
+        return 1;
+    }
+    return 0;
+}
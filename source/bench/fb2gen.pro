@@ -0,0 +1,12 @@
+HEADERS = \
+    fb2corpus.h
+
+SOURCES = \
+    fb2gen.cpp \
+    fb2corpus.cpp
+
+QT -= gui
+
+CONFIG += console
+
+TARGET = fb2gen
@@ -3,6 +3,8 @@
 #include <QTranslator>
 
 #include "fb2app.hpp"
+#include "fb2batch.h"
+#include "fb2trace.h"
 #include "fb2logs.hpp"
 #include "fb2main.hpp"
 
@@ -26,6 +28,8 @@ void FbApplication::handleMessage(QtMsgType type, const char *msg)
     emit logMessage(type, QString::fromUtf8(msg));
 }
 
+#ifndef FB2_NO_MAIN
+
 static void fb2MessageHandler(QtMsgType type, const char *msg)
 {
     ((FbApplication*)qApp)->handleMessage(type, msg);
@@ -34,6 +38,17 @@ static void fb2MessageHandler(QtMsgType type, const char *msg)
 int main(int argc, char *argv[])
 {
     Q_INIT_RESOURCE(fb2edit);
+    FbTrace::startup();
+
+    if (FbBatch::isBatch(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        app.setApplicationName(QString(PACKAGE_NAME));
+        app.setOrganizationName(QString(PACKAGE_VENDOR));
+        app.setApplicationVersion(QString(PACKAGE_VERSION));
+        int result = FbBatch::execute(app.arguments());
+        FbTrace::shutdown();
+        return result;
+    }
 
     FbApplication app(argc, argv);
     app.setApplicationName(QString(PACKAGE_NAME));
@@ -53,5 +68,9 @@ int main(int argc, char *argv[])
 
     qInstallMsgHandler(fb2MessageHandler);
 
-    return app.exec();
+    int result = app.exec();
+    FbTrace::shutdown();
+    return result;
 }
+
+#endif // FB2_NO_MAIN
@@ -0,0 +1,418 @@
+#include "fb2batch.h"
+#include "fb2norm.hpp"
+#include "fb2trace.h"
+#include "fb2utils.h"
+#include "fb2xml.hpp"
+#include "fb2xml2.h"
+
+#include <QAbstractMessageHandler>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QSet>
+#include <QSourceLocation>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QTime>
+#include <QUrl>
+#include <QXmlSchema>
+#include <QXmlSchemaValidator>
+#include <QtAlgorithms>
+
+//---------------------------------------------------------------------------
+//  FbStatsHandler
+//---------------------------------------------------------------------------
+
+namespace {
+
+class FbStatsHandler : public FbXmlHandler
+{
+public:
+    explicit FbStatsHandler(QHash<QString, int> &stats)
+        : m_stats(stats) {}
+    bool fatalError(const QXmlParseException &exception);
+    const QString & message() const { return m_message; }
+
+private:
+    class StatsHandler : public NodeHandler
+    {
+    public:
+        explicit StatsHandler(QHash<QString, int> &stats, const QString &name)
+            : NodeHandler(name), m_stats(stats) { m_stats[name]++; }
+    protected:
+        virtual NodeHandler * NewTag(const QString &name, const QXmlAttributes &attributes);
+        virtual void TxtTag(const QString &text);
+    private:
+        QHash<QString, int> &m_stats;
+    };
+
+protected:
+    virtual NodeHandler * CreateRoot(const QString &name, const QXmlAttributes &attributes);
+
+private:
+    QHash<QString, int> &m_stats;
+    QString m_message;
+};
+
+FbXmlHandler::NodeHandler * FbStatsHandler::StatsHandler::NewTag(const QString &name, const QXmlAttributes &attributes)
+{
+    Q_UNUSED(attributes);
+    return new StatsHandler(m_stats, name);
+}
+
+void FbStatsHandler::StatsHandler::TxtTag(const QString &text)
+{
+    m_stats["#chars"] += text.length();
+    if (Name() == "p" || Name() == "v") m_stats["#words"] += text.split(' ', QString::SkipEmptyParts).count();
+}
+
+FbXmlHandler::NodeHandler * FbStatsHandler::CreateRoot(const QString &name, const QXmlAttributes &attributes)
+{
+    Q_UNUSED(attributes);
+    if (name != "fictionbook") {
+        m_error = QObject::tr("The file is not an FB2 file.");
+        return 0;
+    }
+    return new StatsHandler(m_stats, name);
+}
+
+bool FbStatsHandler::fatalError(const QXmlParseException &exception)
+{
+    m_message = QString("%1:%2 %3").arg(exception.lineNumber()).arg(exception.columnNumber()).arg(exception.message());
+    return false;
+}
+
+//---------------------------------------------------------------------------
+//  FbBatchMessages
+//---------------------------------------------------------------------------
+
+class FbBatchMessages : public QAbstractMessageHandler
+{
+public:
+    FbBatchMessages() : QAbstractMessageHandler(0) {}
+    const QString & message() const { return m_message; }
+
+protected:
+    void handleMessage(QtMsgType type, const QString &description, const QUrl &identifier, const QSourceLocation &sourceLocation)
+    {
+        Q_UNUSED(identifier);
+        if (type == QtDebugMsg || !m_message.isEmpty()) return;
+        QString text = description;
+        text.remove(QRegExp("<[^>]*>"));
+        m_message = QString("%1:%2 %3").arg(sourceLocation.line()).arg(sourceLocation.column()).arg(text.simplified());
+    }
+
+private:
+    QString m_message;
+};
+
+// A QXmlSchema may be used by one thread at a time, the workers run at once so each loads its own
+QXmlSchema * fb2schema()
+{
+    static QThreadStorage<QXmlSchema*> storage;
+    if (!storage.hasLocalData()) {
+        QXmlSchema *schema = new QXmlSchema;
+        schema->load(QUrl("qrc:/fb2/FictionBook2.1.xsd"));
+        storage.setLocalData(schema);
+    }
+    return storage.localData();
+}
+
+bool largerFirst(const FbBatch::Input &a, const FbBatch::Input &b)
+{
+    return a.size > b.size;
+}
+
+}
+
+//---------------------------------------------------------------------------
+//  FbBatch
+//---------------------------------------------------------------------------
+
+bool FbBatch::isBatch(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--batch") == 0) return true;
+    }
+    return false;
+}
+
+int FbBatch::execute(const QStringList &args)
+{
+    QTextStream err(stderr);
+    QString mode, output, summary;
+    QStringList paths;
+    int jobs = QThread::idealThreadCount();
+
+    for (int i = 1; i < args.count(); i++) {
+        const QString &arg = args.at(i);
+        bool last = i + 1 == args.count();
+        if (arg == "--batch" && !last) {
+            mode = args.at(++i);
+        } else if (arg == "--output" && !last) {
+            output = args.at(++i);
+        } else if (arg == "--summary" && !last) {
+            summary = args.at(++i);
+        } else if (arg == "--jobs" && !last) {
+            jobs = args.at(++i).toInt();
+        } else if (arg.startsWith("--")) {
+            mode.clear();
+            break;
+        } else {
+            paths << arg;
+        }
+    }
+
+    Mode value;
+    if (mode == "normalize") value = Normalize;
+    else if (mode == "validate") value = Validate;
+    else if (mode == "stats") value = Stats;
+    else {
+        err << "Usage: fb2edit --batch normalize|validate|stats [--output DIR] [--jobs N] [--summary FILE] FILE|DIR...\n";
+        return 2;
+    }
+
+    if (!output.isEmpty() && !QDir().mkpath(output)) {
+        err << "Cannot create directory " << output << "\n";
+        return 2;
+    }
+
+    FbBatch batch(value, output);
+    foreach (const QString &path, paths) batch.append(path);
+
+    QTime time;
+    time.start();
+    int failed = batch.run(jobs);
+    QString json = batch.summary(time.elapsed());
+
+    if (summary.isEmpty()) {
+        QTextStream(stdout) << json;
+    } else {
+        QFile file(summary);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "Cannot write " << summary << "\n";
+            return 2;
+        }
+        file.write(json.toUtf8());
+    }
+    return failed ? 1 : 0;
+}
+
+FbBatch::FbBatch(Mode mode, const QString &output)
+    : m_mode(mode)
+    , m_output(output)
+{
+}
+
+void FbBatch::append(const QString &path)
+{
+    QFileInfo info(path);
+    if (info.isDir()) {
+        QDir root(path);
+        QStringList filters;
+        filters << "*.fb2";
+        QDirIterator it(path, filters, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            Input input;
+            input.file = it.filePath();
+            input.name = root.relativeFilePath(input.file);
+            input.size = it.fileInfo().size();
+            m_inputs << input;
+        }
+    } else {
+        Input input;
+        input.file = path;
+        input.name = info.fileName();
+        input.size = info.size();
+        m_inputs << input;
+    }
+}
+
+int FbBatch::run(int jobs)
+{
+    // QThreadPool hands out tasks from one shared queue, so starting
+    // with the largest files keeps the workers evenly loaded at the end
+    qSort(m_inputs.begin(), m_inputs.end(), largerFirst);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, jobs));
+    QSet<QString> targets;
+    foreach (const Input &input, m_inputs) {
+        // Two workers must never write the same file
+        if (m_mode == Normalize && !m_output.isEmpty()) {
+            QString path = QDir::cleanPath(target(input));
+            if (targets.contains(path)) {
+                Result result;
+                result.file = input.file;
+                result.message = QObject::tr("Duplicate target %1").arg(path);
+                result.bytes = input.size;
+                result.msecs = 0;
+                result.ok = false;
+                m_results << result;
+                continue;
+            }
+            targets.insert(path);
+        }
+        pool.start(new FbBatchTask(*this, input));
+    }
+    pool.waitForDone();
+
+    int failed = 0;
+    foreach (const Result &result, m_results) if (!result.ok) failed++;
+    return failed;
+}
+
+void FbBatch::process(const Input &input)
+{
+    const QString &file = input.file;
+    Result result;
+    result.file = file;
+    result.bytes = input.size;
+    result.ok = false;
+
+    QTime time;
+    time.start();
+    FB2_TRACE("FbBatch::process");
+    switch (m_mode) {
+        case Normalize: result.ok = normalize(input, result); break;
+        case Validate:  result.ok = validate(file, result);  break;
+        case Stats:     result.ok = stats(file, result);     break;
+    }
+    result.msecs = time.elapsed();
+
+    QMutexLocker locker(&m_mutex);
+    Q_UNUSED(locker);
+    m_results << result;
+}
+
+// The output tree mirrors each file's path below the argument it came from
+QString FbBatch::target(const Input &input) const
+{
+    if (m_output.isEmpty()) return input.file;
+    return QDir(m_output).filePath(input.name);
+}
+
+bool FbBatch::normalize(const Input &input, Result &result)
+{
+    QString path = target(input);
+    if (!QDir().mkpath(QFileInfo(path).path())) {
+        result.message = QObject::tr("Cannot create directory %1").arg(QFileInfo(path).path());
+        return false;
+    }
+    return FbNormHandler::normalize(input.file, path, result.message);
+}
+
+bool FbBatch::validate(const QString &file, Result &result)
+{
+    QXmlSchema *schema = fb2schema();
+    if (!schema->isValid()) {
+        result.message = QObject::tr("Schema is not valid");
+        return false;
+    }
+
+    QFile input(file);
+    if (!input.open(QIODevice::ReadOnly)) {
+        result.message = input.errorString();
+        return false;
+    }
+
+    FbBatchMessages messages;
+    QXmlSchemaValidator validator(*schema);
+    validator.setMessageHandler(&messages);
+    bool ok = validator.validate(&input, QUrl::fromLocalFile(file));
+    result.message = messages.message();
+    return ok;
+}
+
+bool FbBatch::stats(const QString &file, Result &result)
+{
+    QFile input(file);
+    if (!input.open(QIODevice::ReadOnly)) {
+        result.message = input.errorString();
+        return false;
+    }
+
+    FbStatsHandler handler(result.stats);
+#ifdef FB2_USE_LIBXML2
+    XML2::XmlReader reader;
+#else
+    QXmlSimpleReader reader;
+#endif
+    reader.setContentHandler(&handler);
+    reader.setErrorHandler(&handler);
+
+#ifdef FB2_USE_LIBXML2
+    bool ok = reader.parse(&input);
+#else
+    QXmlInputSource source(&input);
+    bool ok = reader.parse(source);
+#endif
+    result.message = handler.message();
+    if (result.message.isEmpty()) result.message = handler.errorString();
+    return ok;
+}
+
+QString FbBatch::modeName(Mode mode)
+{
+    switch (mode) {
+        case Normalize: return "normalize";
+        case Validate:  return "validate";
+        case Stats:     return "stats";
+    }
+    return QString();
+}
+
+double FbBatch::mbps(qint64 bytes, int msecs)
+{
+    return msecs ? bytes * 1000.0 / msecs / (1 << 20) : 0;
+}
+
+QString FbBatch::summary(int msecs) const
+{
+    qint64 bytes = 0;
+    int failed = 0;
+    foreach (const Result &result, m_results) {
+        bytes += result.bytes;
+        if (!result.ok) failed++;
+    }
+
+    QString json;
+    QTextStream out(&json);
+    out << "{\n";
+    out << "  \"mode\": " << jsString(modeName(m_mode)) << ",\n";
+    out << "  \"files\": " << m_results.count() << ",\n";
+    out << "  \"failed\": " << failed << ",\n";
+    out << "  \"bytes\": " << bytes << ",\n";
+    out << "  \"msecs\": " << msecs << ",\n";
+    out << "  \"mbps\": " << QString::number(mbps(bytes, msecs), 'f', 2) << ",\n";
+    out << "  \"results\": [";
+    for (int i = 0; i < m_results.count(); i++) {
+        const Result &result = m_results.at(i);
+        out << (i ? ",\n" : "\n") << "    {";
+        out << "\"file\": " << jsString(result.file);
+        out << ", \"ok\": " << (result.ok ? "true" : "false");
+        out << ", \"bytes\": " << result.bytes;
+        out << ", \"msecs\": " << result.msecs;
+        out << ", \"mbps\": " << QString::number(mbps(result.bytes, result.msecs), 'f', 2);
+        if (!result.message.isEmpty()) out << ", \"message\": " << jsString(result.message);
+        if (!result.stats.isEmpty()) {
+            QStringList keys = result.stats.keys();
+            keys.sort();
+            out << ", \"stats\": {";
+            for (int j = 0; j < keys.count(); j++) {
+                out << (j ? ", " : "") << jsString(keys.at(j)) << ": " << result.stats.value(keys.at(j));
+            }
+            out << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    out.flush();
+    return json;
+}
@@ -0,0 +1,71 @@
+#ifndef FB2BATCH_H
+#define FB2BATCH_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QRunnable>
+#include <QStringList>
+
+class FbBatch
+{
+public:
+    enum Mode {
+        Normalize,
+        Validate,
+        Stats,
+    };
+
+    struct Input {
+        QString file;
+        QString name;   // path below the argument the file was found under
+        qint64 size;
+    };
+
+    struct Result {
+        QString file;
+        QString message;
+        qint64 bytes;
+        int msecs;
+        bool ok;
+        QHash<QString, int> stats;
+    };
+
+    static bool isBatch(int argc, char *argv[]);
+    static double mbps(qint64 bytes, int msecs);
+    static int execute(const QStringList &args);
+
+    explicit FbBatch(Mode mode, const QString &output);
+    void append(const QString &path);
+    int run(int jobs);
+    void process(const Input &input);
+    QString summary(int msecs) const;
+
+private:
+    bool normalize(const Input &input, Result &result);
+    bool validate(const QString &file, Result &result);
+    bool stats(const QString &file, Result &result);
+    QString target(const Input &input) const;
+    static QString modeName(Mode mode);
+
+private:
+    const Mode m_mode;
+    const QString m_output;
+    QList<Input> m_inputs;
+    QList<Result> m_results;
+    QMutex m_mutex;
+};
+
+class FbBatchTask : public QRunnable
+{
+public:
+    explicit FbBatchTask(FbBatch &batch, const FbBatch::Input &input)
+        : m_batch(batch), m_input(input) {}
+    void run() { m_batch.process(m_input); }
+
+private:
+    FbBatch &m_batch;
+    const FbBatch::Input m_input;
+};
+
+#endif // FB2BATCH_H
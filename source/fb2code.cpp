@@ -2,17 +2,32 @@
 
 #include <QXmlSchema>
 #include <QAbstractMessageHandler>
+#include <QMutex>
+#include <QRegExp>
 #include <QXmlSchemaValidator>
 
 #include "fb2dlgs.hpp"
+#include "fb2highlight.h"
+#include "fb2imgs.hpp"
 
 //---------------------------------------------------------------------------
-//  FbHighlighter
+//  FbSchemaHandler
 //---------------------------------------------------------------------------
 
 class FbSchemaHandler : public QAbstractMessageHandler
 {
     public:
+        class Message
+        {
+        public:
+            Message(QtMsgType type, const QString &text, const QSourceLocation &location)
+                : type(type), text(text), line(location.line()), column(location.column()) {}
+            QtMsgType type;
+            QString text;
+            int line;
+            int column;
+        };
+
         FbSchemaHandler()
             : QAbstractMessageHandler(0)
         {
@@ -20,428 +35,117 @@ class FbSchemaHandler : public QAbstractMessageHandler
 
         QString statusMessage() const
         {
-            return m_description;
+            return m_messages.isEmpty() ? QString() : m_messages.last().text;
         }
 
-        int line() const
+        const QList<Message> & messages() const
         {
-            return m_sourceLocation.line();
+            return m_messages;
         }
 
-        int column() const
+        void clear()
         {
-            return m_sourceLocation.column();
+            m_messages.clear();
         }
 
     protected:
         virtual void handleMessage(QtMsgType type, const QString &description,
                                    const QUrl &identifier, const QSourceLocation &sourceLocation)
         {
-            Q_UNUSED(type);
             Q_UNUSED(identifier);
 
-            m_messageType = type;
-            m_description = description;
-            m_sourceLocation = sourceLocation;
+            QString text = description;
+            text.remove(QRegExp("<[^>]*>"));
+            text.replace("&lt;", "<").replace("&gt;", ">").replace("&quot;", "\"").replace("&amp;", "&");
+            m_messages << Message(type, text.simplified(), sourceLocation);
         }
 
     private:
-        QtMsgType m_messageType;
-        QString m_description;
-        QSourceLocation m_sourceLocation;
+        QList<Message> m_messages;
 };
 
 //---------------------------------------------------------------------------
-//  FbHighlighter
+//  FbValidateThread
 //---------------------------------------------------------------------------
 
-#include <QXmlInputSource>
-#include <QtGui>
-
-#include <QSyntaxHighlighter>
-
-class FbHighlighter : public QSyntaxHighlighter
-{
-public:
-    FbHighlighter(QObject* parent);
-    FbHighlighter(QTextDocument* parent);
-    FbHighlighter(QTextEdit* parent);
-    ~FbHighlighter();
-
-    enum HighlightType
-    {
-        SyntaxChar,
-        ElementName,
-        Comment,
-        AttributeName,
-        AttributeValue,
-        Error,
-        Other
-    };
-
-    void setHighlightColor(HighlightType type, QColor color, bool foreground = true);
-    void setHighlightFormat(HighlightType type, QTextCharFormat format);
-
-protected:
-    void highlightBlock(const QString& rstrText);
-    int  processDefaultText(int i, const QString& rstrText);
-
-private:
-    void init();
-
-    QTextCharFormat fmtSyntaxChar;
-    QTextCharFormat fmtElementName;
-    QTextCharFormat fmtComment;
-    QTextCharFormat fmtAttributeName;
-    QTextCharFormat fmtAttributeValue;
-    QTextCharFormat fmtError;
-    QTextCharFormat fmtOther;
-
-    enum ParsingState
-    {
-        NoState = 0,
-        ExpectElementNameOrSlash,
-        ExpectElementName,
-        ExpectAttributeOrEndOfElement,
-        ExpectEqual,
-        ExpectAttributeValue
-    };
-
-    enum BlockState
-    {
-        NoBlock = -1,
-        InComment,
-        InElement
-    };
-
-    ParsingState state;
-};
-
-static const QColor DEFAULT_SYNTAX_CHAR     = Qt::blue;
-static const QColor DEFAULT_ELEMENT_NAME    = Qt::darkRed;
-static const QColor DEFAULT_COMMENT         = Qt::darkGray;
-static const QColor DEFAULT_ATTRIBUTE_NAME  = Qt::red;
-static const QColor DEFAULT_ATTRIBUTE_VALUE = Qt::darkGreen;
-static const QColor DEFAULT_ERROR           = Qt::darkMagenta;
-static const QColor DEFAULT_OTHER           = Qt::black;
-
-// Regular expressions for parsing XML borrowed from:
-// http://www.cs.sfu.ca/~cameron/REX.html
-static const QString EXPR_COMMENT			= "<!--[^-]*-([^-][^-]*-)*->";
-static const QString EXPR_COMMENT_BEGIN		= "<!--";
-static const QString EXPR_COMMENT_END		= "[^-]*-([^-][^-]*-)*->";
-static const QString EXPR_ATTRIBUTE_VALUE	= "\"[^<\"]*\"|'[^<']*'";
-static const QString EXPR_NAME				= "([A-Za-z_:]|[^\\x00-\\x7F])([A-Za-z0-9_:.-]|[^\\x00-\\x7F])*";
-
-FbHighlighter::FbHighlighter(QObject* parent)
-: QSyntaxHighlighter(parent)
-{
-    init();
-}
-
-FbHighlighter::FbHighlighter(QTextDocument* parent)
-: QSyntaxHighlighter(parent)
-{
-    init();
-}
-
-FbHighlighter::FbHighlighter(QTextEdit* parent)
-: QSyntaxHighlighter(parent)
-{
-    init();
-}
+// A QXmlSchema may be used by one thread at a time. It is loaded once on the GUI
+// thread, and the validation threads take turns with it under schemaMutex.
+static QMutex schemaMutex;
 
-FbHighlighter::~FbHighlighter()
+static QXmlSchema & fb2schema(QString &message)
 {
+    static FbSchemaHandler *handler = 0;
+    static QXmlSchema *schema = 0;
+    if (!schema) {
+        handler = new FbSchemaHandler;
+        schema = new QXmlSchema;
+        schema->setMessageHandler(handler);
+        schema->load(QUrl("qrc:/fb2/FictionBook2.1.xsd"));
+    }
+    message = handler->statusMessage();
+    return *schema;
 }
 
-void FbHighlighter::init()
-{
-    fmtSyntaxChar.setForeground(DEFAULT_SYNTAX_CHAR);
-    fmtElementName.setForeground(DEFAULT_ELEMENT_NAME);
-    fmtComment.setForeground(DEFAULT_COMMENT);
-    fmtAttributeName.setForeground(DEFAULT_ATTRIBUTE_NAME);
-    fmtAttributeValue.setForeground(DEFAULT_ATTRIBUTE_VALUE);
-    fmtError.setForeground(DEFAULT_ERROR);
-    fmtOther.setForeground(DEFAULT_OTHER);
+void FbValidateThread::execute(FbCodeEdit *parent, const QByteArray &data, bool verbose)
+{
+    // No parent, the editor may close while the thread is still running
+    QString message;
+    QXmlSchema &schema = fb2schema(message);
+    FbValidateThread *thread = new FbValidateThread(schema, message, data, verbose);
+    connect(thread, SIGNAL(warning(int,int,QString)), parent, SIGNAL(warning(int,int,QString)));
+    connect(thread, SIGNAL(error(int,int,QString)), parent, SIGNAL(error(int,int,QString)));
+    connect(thread, SIGNAL(fatal(int,int,QString)), parent, SIGNAL(fatal(int,int,QString)));
+    connect(thread, SIGNAL(validated(bool,int,int,QString)), parent, SLOT(validated(bool,int,int,QString)));
+    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+    thread->start();
 }
 
-void FbHighlighter::setHighlightColor(HighlightType type, QColor color, bool foreground)
+FbValidateThread::FbValidateThread(const QXmlSchema &schema, const QString &message, const QByteArray &data, bool verbose)
+    : QThread()
+    , m_schema(schema)
+    , m_message(message)
+    , m_data(data)
+    , m_verbose(verbose)
 {
-    QTextCharFormat format;
-    if (foreground)
-        format.setForeground(color);
-    else
-        format.setBackground(color);
-    setHighlightFormat(type, format);
-}
-
-void FbHighlighter::setHighlightFormat(HighlightType type, QTextCharFormat format)
-{
-    switch (type)
-    {
-        case SyntaxChar:
-            fmtSyntaxChar = format;
-            break;
-        case ElementName:
-            fmtElementName = format;
-            break;
-        case Comment:
-            fmtComment = format;
-            break;
-        case AttributeName:
-            fmtAttributeName = format;
-            break;
-        case AttributeValue:
-            fmtAttributeValue = format;
-            break;
-        case Error:
-            fmtError = format;
-            break;
-        case Other:
-            fmtOther = format;
-            break;
-    }
-    rehighlight();
 }
 
-void FbHighlighter::highlightBlock(const QString& text)
+void FbValidateThread::run()
 {
-    int i = 0;
-    int pos = 0;
-    int brackets = 0;
-
-    state = (previousBlockState() == InElement ? ExpectAttributeOrEndOfElement : NoState);
+    QMutexLocker locker(&schemaMutex);
 
-    if (previousBlockState() == InComment)
-    {
-        // search for the end of the comment
-        QRegExp expression(EXPR_COMMENT_END);
-        pos = expression.indexIn(text, i);
-
-        if (pos >= 0)
-        {
-            // end comment found
-            const int iLength = expression.matchedLength();
-            setFormat(0, iLength - 3, fmtComment);
-            setFormat(iLength - 3, 3, fmtSyntaxChar);
-            i += iLength; // skip comment
-        }
-        else
-        {
-            // in comment
-            setFormat(0, text.length(), fmtComment);
-            setCurrentBlockState(InComment);
-            return;
-        }
+    if (!m_schema.isValid()) {
+        emit validated(false, 0, 0, tr("Schema is not valid: ") + m_message);
+        return;
     }
 
-    for (; i < text.length(); i++)
-    {
-        switch (text.at(i).toAscii())
-        {
-        case '<':
-            brackets++;
-            if (brackets == 1)
-            {
-                setFormat(i, 1, fmtSyntaxChar);
-                state = ExpectElementNameOrSlash;
-            }
-            else
-            {
-                // wrong bracket nesting
-                setFormat(i, 1, fmtError);
-            }
-            break;
-
-        case '>':
-            brackets--;
-            if (brackets == 0)
-            {
-                setFormat(i, 1, fmtSyntaxChar);
-            }
-            else
-            {
-                // wrong bracket nesting
-                setFormat( i, 1, fmtError);
-            }
-            state = NoState;
-            break;
-
-        case '/':
-            if (state == ExpectElementNameOrSlash)
-            {
-                state = ExpectElementName;
-                setFormat(i, 1, fmtSyntaxChar);
-            }
-            else
-            {
-                if (state == ExpectAttributeOrEndOfElement)
-                {
-                    setFormat(i, 1, fmtSyntaxChar);
-                }
-                else
-                {
-                    processDefaultText(i, text);
-                }
-            }
-            break;
-
-        case '=':
-            if (state == ExpectEqual)
-            {
-                state = ExpectAttributeValue;
-                setFormat(i, 1, fmtOther);
-            }
-            else
-            {
-                processDefaultText(i, text);
-            }
-            break;
-
-        case '\'':
-        case '\"':
-            if (state == ExpectAttributeValue)
-            {
-                // search attribute value
-                QRegExp expression(EXPR_ATTRIBUTE_VALUE);
-                pos = expression.indexIn(text, i);
-
-                if (pos == i) // attribute value found ?
-                {
-                    const int iLength = expression.matchedLength();
-
-                    setFormat(i, 1, fmtOther);
-                    setFormat(i + 1, iLength - 2, fmtAttributeValue);
-                    setFormat(i + iLength - 1, 1, fmtOther);
-
-                    i += iLength - 1; // skip attribute value
-                    state = ExpectAttributeOrEndOfElement;
-                }
-                else
-                {
-                    processDefaultText(i, text);
-                }
-            }
-            else
-            {
-                processDefaultText(i, text);
-            }
-            break;
-
-        case '!':
-            if (state == ExpectElementNameOrSlash)
-            {
-                // search comment
-                QRegExp expression(EXPR_COMMENT);
-                pos = expression.indexIn(text, i - 1);
-
-                if (pos == i - 1) // comment found ?
-                {
-                    const int iLength = expression.matchedLength();
-
-                    setFormat(pos, 4, fmtSyntaxChar);
-                    setFormat(pos + 4, iLength - 7, fmtComment);
-                    setFormat(iLength - 3, 3, fmtSyntaxChar);
-                    i += iLength - 2; // skip comment
-                    state = NoState;
-                    brackets--;
-                }
-                else
-                {
-                    // Try find multiline comment
-                    QRegExp expression(EXPR_COMMENT_BEGIN); // search comment start
-                    pos = expression.indexIn(text, i - 1);
-
-                    //if (pos == i - 1) // comment found ?
-                    if (pos >= i - 1)
-                    {
-                        setFormat(i, 3, fmtSyntaxChar);
-                        setFormat(i + 3, text.length() - i - 3, fmtComment);
-                        setCurrentBlockState(InComment);
-                        return;
-                    }
-                    else
-                    {
-                        processDefaultText(i, text);
-                    }
-                }
-            }
-            else
-            {
-                processDefaultText(i, text);
+    FbSchemaHandler handler;
+    QXmlSchemaValidator validator(m_schema);
+    validator.setMessageHandler(&handler);
+    bool valid = validator.validate(m_data);
+
+    if (m_verbose) {
+        foreach (const FbSchemaHandler::Message &msg, handler.messages()) {
+            switch (msg.type) {
+                case QtDebugMsg: break;
+                case QtWarningMsg: emit warning(msg.line, msg.column, msg.text); break;
+                case QtCriticalMsg: emit error(msg.line, msg.column, msg.text); break;
+                case QtFatalMsg: emit fatal(msg.line, msg.column, msg.text); break;
             }
-
-            break;
-
-        default:
-            const int iLength = processDefaultText(i, text);
-            if (iLength > 0)
-                i += iLength - 1;
-            break;
         }
     }
 
-    if (state == ExpectAttributeOrEndOfElement)
-    {
-        setCurrentBlockState(InElement);
+    if (valid) {
+        emit validated(true, 0, 0, QString());
+    } else if (handler.messages().isEmpty()) {
+        emit validated(false, 0, 0, QString());
+    } else {
+        const FbSchemaHandler::Message &msg = handler.messages().first();
+        emit validated(false, msg.line, msg.column, msg.text);
     }
 }
 
-int FbHighlighter::processDefaultText(int i, const QString& text)
-{
-    // length of matched text
-    int iLength = 0;
-
-    switch(state)
-    {
-    case ExpectElementNameOrSlash:
-    case ExpectElementName:
-        {
-            // search element name
-            QRegExp expression(EXPR_NAME);
-            const int pos = expression.indexIn(text, i);
-
-            if (pos == i) // found ?
-            {
-                iLength = expression.matchedLength();
-
-                setFormat(pos, iLength, fmtElementName);
-                state = ExpectAttributeOrEndOfElement;
-            }
-            else
-            {
-                setFormat(i, 1, fmtOther);
-            }
-        }
-        break;
-
-    case ExpectAttributeOrEndOfElement:
-        {
-            // search attribute name
-            QRegExp expression(EXPR_NAME);
-            const int pos = expression.indexIn(text, i);
-
-            if (pos == i) // found ?
-            {
-                iLength = expression.matchedLength();
-
-                setFormat(pos, iLength, fmtAttributeName);
-                state = ExpectEqual;
-            }
-            else
-            {
-                setFormat(i, 1, fmtOther);
-            }
-        }
-        break;
-
-    default:
-        setFormat(i, 1, fmtOther);
-        break;
-    }
-    return iLength;
-}
+#include <QXmlInputSource>
+#include <QtGui>
 
 //---------------------------------------------------------------------------
 //  FbCodeEdit
@@ -451,9 +155,15 @@ qreal FbCodeEdit::baseFontSize = 10;
 qreal FbCodeEdit::zoomRatioMin = 0.2;
 qreal FbCodeEdit::zoomRatioMax = 5.0;
 
+static const int chunkSize = 0x10000;
+
+static const QString binaryComment = "<!-- fb2:%1 %2 bytes -->";
+
 FbCodeEdit::FbCodeEdit(QWidget *parent) : QPlainTextEdit(parent)
 {
     lineNumberArea = new LineNumberArea(this);
+    m_store = new FbStore(this);
+    m_position = 0;
     FbHighlighter *highlighter = new FbHighlighter(this);
     highlighter->setDocument( document() );
 
@@ -461,6 +171,18 @@ FbCodeEdit::FbCodeEdit(QWidget *parent) : QPlainTextEdit(parent)
     connect(this, SIGNAL(updateRequest(QRect,int)), this, SLOT(updateLineNumberArea(QRect,int)));
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(highlightCurrentLine()));
 
+    setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(this, SIGNAL(customContextMenuRequested(QPoint)), SLOT(contextMenu(QPoint)));
+
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), SLOT(loadChunk()));
+
+    m_autoValidate = m_validating = m_revalidate = m_verbose = false;
+    m_validateTimer.setSingleShot(true);
+    m_validateTimer.setInterval(1000);
+    connect(&m_validateTimer, SIGNAL(timeout()), SLOT(validateLater()));
+    connect(this, SIGNAL(textChanged()), &m_validateTimer, SLOT(start()));
+
     zoomRatio = 1;
 
     QFont f("Monospace", baseFontSize);
@@ -549,10 +271,189 @@ bool FbCodeEdit::read(QIODevice *device)
     delete device;
     QXmlInputSource source;
     source.setData(data);
-    setPlainText(source.data());
+    setPlainText(QString());
+    document()->setModified(false);
+    document()->setUndoRedoEnabled(false);
+    m_autoValidate = false;
+    m_pending = collapse(source.data());
+    m_position = 0;
+    loadChunk();
     return true;
 }
 
+void FbCodeEdit::loadChunk()
+{
+    int size = m_pending.size() - m_position;
+    if (size > chunkSize) {
+        int pos = m_pending.lastIndexOf('\n', m_position + chunkSize);
+        size = pos > m_position ? pos + 1 - m_position : chunkSize;
+    }
+
+    // Keep edits made while the rest of the file streams in
+    bool modified = document()->isModified();
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    int offset = cursor.position();
+    cursor.insertText(m_pending.mid(m_position, size));
+    if (!modified) document()->setModified(false);
+    trackPlaceholders(offset, m_position, m_position + size);
+    m_position += size;
+
+    if (m_position < m_pending.size()) {
+        m_timer.start(0);
+        return;
+    }
+
+    m_pending.clear();
+    m_position = 0;
+    document()->setUndoRedoEnabled(true);
+}
+
+void FbCodeEdit::setText(const QString &text)
+{
+    m_timer.stop();
+    m_pending.clear();
+    m_position = 0;
+    document()->setUndoRedoEnabled(true);
+    QString collapsed = collapse(text);
+    setPlainText(collapsed);
+    trackPlaceholders(0, 0, collapsed.length());
+    m_autoValidate = false;
+}
+
+QString FbCodeEdit::text() const
+{
+    QString text = toPlainText();
+    if (!m_pending.isEmpty()) text += m_pending.mid(m_position);
+    return expand(text);
+}
+
+QString FbCodeEdit::collapse(const QString &text)
+{
+    delete m_store;
+    m_store = new FbStore(this);
+    m_placeholders.clear();
+
+    QString result;
+    QRegExp exp("\\bid=[\"']([^\"']+)[\"']");
+    int last = 0;
+    while (true) {
+        int pos = text.indexOf("<binary", last);
+        if (pos < 0) break;
+        int begin = text.indexOf('>', pos);
+        if (begin < 0) break;
+        int end = text.indexOf("</binary>", ++begin);
+        if (end < 0) break;
+
+        QString body = text.mid(begin, end - begin);
+        if (exp.indexIn(text.mid(pos, begin - pos)) < 0 || body.contains('<') || body.contains('&')) {
+            result += text.mid(last, end - last);
+            last = end;
+            continue;
+        }
+
+        QString name = exp.cap(1);
+        QByteArray data = QByteArray::fromBase64(body.toLatin1());
+        m_store->set(name, data);
+        result += text.mid(last, begin - last);
+
+        // expand() writes a line break and then 76 base64 characters a line
+        Placeholder placeholder;
+        placeholder.text = binaryComment.arg(name, QString::number(data.size()));
+        placeholder.position = result.length();
+        placeholder.lines = ((data.size() + 2) / 3 * 4 + 75) / 76 + 1;
+        m_placeholders << placeholder;
+
+        result += placeholder.text;
+        last = end;
+    }
+    if (last == 0) return text;
+    result += text.mid(last);
+    return result;
+}
+
+QString FbCodeEdit::expand(const QString &text) const
+{
+    if (m_store->count() == 0) return text;
+
+    QString result;
+    QRegExp exp(binaryComment.arg("(\\S+)", "\\d+"));
+    int last = 0;
+    int pos;
+    while ((pos = exp.indexIn(text, last)) >= 0) {
+        result += text.mid(last, pos - last);
+        FbBinary *file = m_store->get(exp.cap(1));
+        if (file) {
+            QString data = file->data().toBase64();
+            result += '\n';
+            for (int i = 0; i < data.size(); i += 76) {
+                result += data.mid(i, 76);
+                result += '\n';
+            }
+        } else {
+            result += exp.cap(0);
+        }
+        last = pos + exp.matchedLength();
+    }
+    if (last == 0) return text;
+    result += text.mid(last);
+    return result;
+}
+
+// Messages count lines of the expanded text, each collapsed binary hides its base64 lines.
+// The placeholder cursors follow edits, so no scan of the document is needed.
+int FbCodeEdit::collapsedLine(int line, int &column) const
+{
+    int added = 0;
+    foreach (const Placeholder &placeholder, m_placeholders) {
+        if (placeholder.cursor.isNull()) break;
+        QTextBlock block = placeholder.cursor.block();
+        if (!block.text().contains(placeholder.text)) continue;
+        int number = block.blockNumber() + 1;
+        if (line <= number + added) break;
+        if (line <= number + added + placeholder.lines) {
+            column = 1;
+            return number;
+        }
+        added += placeholder.lines;
+    }
+    return line - added;
+}
+
+// Placeholders between from and to in the collapsed text start at offset in the document
+void FbCodeEdit::trackPlaceholders(int offset, int from, int to)
+{
+    for (int i = 0; i < m_placeholders.count(); ++i) {
+        Placeholder &placeholder = m_placeholders[i];
+        if (placeholder.position < from || placeholder.position >= to) continue;
+        placeholder.cursor = QTextCursor(document());
+        placeholder.cursor.setPosition(offset + placeholder.position - from);
+    }
+}
+
+void FbCodeEdit::expandBinaries()
+{
+    QRegExp exp(binaryComment.arg("\\S+", "\\d+"));
+    QTextCursor edit(document());
+    edit.beginEditBlock();
+    QTextCursor cursor = document()->find(exp);
+    while (!cursor.isNull()) {
+        cursor.insertText(expand(cursor.selectedText()));
+        cursor = document()->find(exp, cursor);
+    }
+    edit.endEditBlock();
+}
+
+void FbCodeEdit::contextMenu(const QPoint &pos)
+{
+    QMenu *menu = createStandardContextMenu();
+    menu->addSeparator();
+    QAction *action = menu->addAction(tr("E&xpand binary data"), this, SLOT(expandBinaries()));
+    action->setEnabled(m_store->count() > 0);
+    menu->exec(mapToGlobal(pos));
+    delete menu;
+}
+
 int FbCodeEdit::lineNumberAreaWidth()
 {
     int digits = 1;
@@ -677,36 +578,55 @@ void FbCodeEdit::setZoomRatio(qreal ratio)
 
 void FbCodeEdit::validate()
 {
-    FbSchemaHandler handler;
+    m_autoValidate = true;
+    startValidation(true);
+}
 
-    QXmlSchema schema;
-    schema.setMessageHandler(&handler);
+void FbCodeEdit::validateLater()
+{
+    if (m_autoValidate) startValidation(false);
+}
 
-    QUrl url("qrc:/fb2/FictionBook2.1.xsd");
-    schema.load(url);
-    if (!schema.isValid()) {
-        status(tr("Schema is not valid: ") + handler.statusMessage());
+void FbCodeEdit::startValidation(bool verbose)
+{
+    m_validateTimer.stop();
+    if (m_validating) {
+        m_revalidate = true;
+        m_verbose = m_verbose || verbose;
         return;
     }
+    m_validating = true;
+    m_revalidate = false;
+    m_verbose = verbose;
+    status(tr("Validation..."));
+    FbValidateThread::execute(this, text().toUtf8(), verbose);
+}
 
-    const QByteArray data = toPlainText().toUtf8();
-    QXmlSchemaValidator validator(schema);
-    if (!validator.validate(data)) {
-        setCursor(handler.line(), handler.column());
-        status(handler.statusMessage());
-    } else {
+void FbCodeEdit::validated(bool valid, int row, int col, const QString &msg)
+{
+    bool verbose = m_verbose;
+    m_validating = false;
+    if (m_revalidate) {
+        startValidation(m_verbose);
+        return;
+    }
+
+    if (valid) {
         status(tr("Validation successful"));
+    } else {
+        if (verbose && row > 0) setCursor(row, col);
+        status(msg);
     }
 }
 
 void FbCodeEdit::setCursor(int line, int column)
 {
-    moveCursor(QTextCursor::Start);
-    for (int i = 1; i < line; ++i)
-        moveCursor(QTextCursor::Down);
-
-    for (int i = 1; i < column; ++i)
-        moveCursor(QTextCursor::Right);
+    line = collapsedLine(line, column);
+    QTextBlock block = document()->findBlockByNumber(qMax(line - 1, 0));
+    if (!block.isValid()) block = document()->lastBlock();
+    QTextCursor cursor(block);
+    cursor.setPosition(block.position() + qBound(0, column - 1, block.length() - 1));
+    setTextCursor(cursor);
 
     QList<QTextEdit::ExtraSelection> extraSelections;
     QTextEdit::ExtraSelection selection;
@@ -5,9 +5,13 @@
 #include <QObject>
 #include <QPlainTextEdit>
 #include <QTextCharFormat>
+#include <QTextCursor>
 #include <QColor>
 #include <QTextEdit>
+#include <QThread>
+#include <QTimer>
 #include <QToolBar>
+#include <QXmlSchema>
 
 #include "fb2mode.h"
 
@@ -18,6 +22,8 @@ class QSize;
 class QWidget;
 QT_END_NAMESPACE
 
+class FbStore;
+
 class FbCodeEdit : public QPlainTextEdit
 {
     Q_OBJECT
@@ -30,7 +36,9 @@ public:
     void connectActions(QToolBar *tool);
     void disconnectActions();
 
-    QString text() const { return toPlainText(); }
+    QString text() const;
+
+    void setText(const QString &text);
 
     bool read(QIODevice *device);
 
@@ -45,17 +53,27 @@ public:
 
 signals:
     void status(const QString &text);
+    void warning(int row, int col, const QString &msg);
+    void error(int row, int col, const QString &msg);
+    void fatal(int row, int col, const QString &msg);
+
+public slots:
+    void expandBinaries();
 
 protected:
     void resizeEvent(QResizeEvent *event);
 
 private slots:
     void clipboardDataChanged();
+    void contextMenu(const QPoint &pos);
+    void loadChunk();
     void updateLineNumberAreaWidth(int newBlockCount);
     void highlightCurrentLine();
     void updateLineNumberArea(const QRect &, int);
     void find();
     void validate();
+    void validateLater();
+    void validated(bool valid, int row, int col, const QString &msg);
     void zoomIn();
     void zoomOut();
     void zoomReset();
@@ -72,13 +90,37 @@ private:
         FbCodeEdit *editor;
     };
 
+    class Placeholder
+    {
+    public:
+        QTextCursor cursor;
+        QString text;
+        int position;
+        int lines;
+    };
+
 private:
     void lineNumberAreaPaintEvent(QPaintEvent *event);
     int lineNumberAreaWidth();
     void setZoomRatio(qreal ratio);
+    QString collapse(const QString &text);
+    QString expand(const QString &text) const;
+    int collapsedLine(int line, int &column) const;
+    void trackPlaceholders(int offset, int from, int to);
+    void startValidation(bool verbose);
 
 private:
     QWidget *lineNumberArea;
+    FbStore *m_store;
+    QList<Placeholder> m_placeholders;
+    QString m_pending;
+    int m_position;
+    QTimer m_timer;
+    QTimer m_validateTimer;
+    bool m_autoValidate;
+    bool m_validating;
+    bool m_revalidate;
+    bool m_verbose;
     FbActionMap m_actions;
     qreal zoomRatio;
     static qreal baseFontSize;
@@ -87,4 +129,30 @@ private:
     friend class FbCodeEdit::LineNumberArea;
 };
 
+class FbValidateThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    static void execute(FbCodeEdit *parent, const QByteArray &data, bool verbose);
+
+signals:
+    void warning(int row, int col, const QString &msg);
+    void error(int row, int col, const QString &msg);
+    void fatal(int row, int col, const QString &msg);
+    void validated(bool valid, int row, int col, const QString &msg);
+
+protected:
+    void run();
+
+private:
+    explicit FbValidateThread(const QXmlSchema &schema, const QString &message, const QByteArray &data, bool verbose);
+
+private:
+    const QXmlSchema m_schema;
+    const QString m_message;
+    const QByteArray m_data;
+    const bool m_verbose;
+};
+
 #endif // FB2CODE_H
@@ -38,22 +38,6 @@ private:
     FbCodeEdit & m_edit;
 };
 
-class FbTextFindDlg : public QDialog
-{
-    Q_OBJECT
-
-public:
-    explicit FbTextFindDlg(FbTextEdit &edit);
-    virtual ~FbTextFindDlg();
-
-private slots:
-    void find();
-
-private:
-    Ui::FbFind * ui;
-    FbTextEdit & m_edit;
-};
-
 class FbSetupDlg : public QDialog
 {
     Q_OBJECT
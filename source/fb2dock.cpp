@@ -3,6 +3,7 @@
 #include "fb2head.hpp"
 #include "fb2page.hpp"
 #include "fb2text.hpp"
+#include "fb2trace.h"
 
 #include <QLayout>
 #include <QtDebug>
@@ -40,6 +41,8 @@ void FbModeAction::switchMode()
 
 FbMainDock::FbMainDock(QWidget *parent)
     : QStackedWidget(parent)
+    , m_codeRevision(-1)
+    , m_textSync(false)
     , isSwitched(false)
 {
     textFrame = new FbTextFrame(this);
@@ -60,39 +63,51 @@ FbMainDock::FbMainDock(QWidget *parent)
     connect(m_text->page(), SIGNAL(error(int,int,QString)), SLOT(error(int,int)));
     connect(m_text->page(), SIGNAL(fatal(int,int,QString)), SLOT(error(int,int)));
     connect(m_text->page(), SIGNAL(status(QString)), parent, SLOT(status(QString)));
+    connect(m_text->page(), SIGNAL(contentsChanged()), SLOT(textEdited()));
+    connect(m_text->page(), SIGNAL(loadFinished(bool)), SLOT(textEdited()));
+    connect(m_text->page()->undoStack(), SIGNAL(indexChanged(int)), SLOT(textEdited()));
     connect(m_text, SIGNAL(modificationChanged(bool)), SLOT(textChanged(bool)));
     connect(m_head, SIGNAL(modificationChanged(bool)), SLOT(textChanged(bool)));
     connect(m_code, SIGNAL(modificationChanged(bool)), SLOT(textChanged(bool)));
     connect(m_head, SIGNAL(status(QString)), parent, SLOT(status(QString)));
     connect(m_code, SIGNAL(status(QString)), parent, SLOT(status(QString)));
+    connect(m_code, SIGNAL(warning(int,int,QString)), parent, SLOT(warning(int,int,QString)));
+    connect(m_code, SIGNAL(error(int,int,QString)), parent, SLOT(error(int,int,QString)));
+    connect(m_code, SIGNAL(fatal(int,int,QString)), parent, SLOT(fatal(int,int,QString)));
     connect(this, SIGNAL(status(QString)), parent, SLOT(status(QString)));
 }
 
 void FbMainDock::switchMode(Fb::Mode mode)
 {
     if (mode == m_mode) return;
+    FB2_TRACE("FbMainDock::switchMode");
     isSwitched = isModified();
+    bool synced = m_textSync && m_code->document()->revision() == m_codeRevision;
     if (currentWidget() == m_code) {
-        QString xml = m_code->toPlainText();
         switch (m_mode) {
-            case Fb::Code: m_text->page()->read(xml); break;
-            case Fb::Html: m_text->setHtml(xml, m_text->url()); break;
+            case Fb::Code: if (!synced) m_text->page()->read(m_code->text()); break;
+            case Fb::Html: m_text->setHtml(m_code->text(), m_text->url()); break;
             default: ;
         }
     } else {
+        if (m_mode == Fb::Head) synced = m_textSync = false;
         switch (mode) {
             case Fb::Code: {
+                if (synced) break;
                 QString xml; int anchor, focus;
                 m_text->save(&xml, anchor, focus);
-                m_code->setPlainText(xml);
+                m_code->setText(xml);
                 QTextCursor cursor = m_code->textCursor();
                 if (anchor > 0) cursor.setPosition(anchor, QTextCursor::MoveAnchor);
                 if (focus > 0) cursor.setPosition(focus, QTextCursor::KeepAnchor);
                 m_code->setTextCursor(cursor);
+                m_codeRevision = m_code->document()->revision();
+                m_textSync = true;
             } break;
             case Fb::Html: {
                 QString html = m_text->toHtml();
-                m_code->setPlainText(html);
+                m_code->setText(html);
+                m_textSync = false;
             } break;
             default: ;
         }
@@ -156,8 +171,9 @@ void FbMainDock::setModeHtml()
 
 void FbMainDock::error(int row, int col)
 {
+    // The XML must be brought in sync with the text before the row means anything
+    switchMode(Fb::Code);
     m_code->setCursor(row, col);
-    setMode(Fb::Code);
 }
 
 bool FbMainDock::load(const QString &filename)
@@ -183,7 +199,7 @@ bool FbMainDock::save(QIODevice *device, const QString &codec)
 {
     if (currentWidget() == m_code) {
         QTextStream out(device);
-        out << m_code->toPlainText();
+        out << m_code->text();
     } else {
         isSwitched = false;
         m_text->save(device, codec);
@@ -191,6 +207,11 @@ bool FbMainDock::save(QIODevice *device, const QString &codec)
     return true;
 }
 
+void FbMainDock::textEdited()
+{
+    m_textSync = false;
+}
+
 void FbMainDock::textChanged(bool changed)
 {
     emit modificationChanged(isSwitched || changed);
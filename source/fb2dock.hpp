@@ -39,6 +39,7 @@ signals:
 
 private slots:
     void textChanged(bool changed);
+    void textEdited();
     void error(int row, int col);
 
 private:
@@ -56,6 +57,8 @@ private:
     FbHeadEdit *m_head;
     FbCodeEdit *m_code;
     QToolBar *m_tool;
+    int m_codeRevision;
+    bool m_textSync;
     bool isSwitched;
     Fb::Mode m_mode;
 };
@@ -0,0 +1,509 @@
+#include "fb2find.hpp"
+
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QRegExp>
+#include <QTreeView>
+#include <QVBoxLayout>
+#include <QWebFrame>
+#include <QtAlgorithms>
+
+#include "fb2html.h"
+#include "fb2page.hpp"
+#include "fb2text.hpp"
+#include "fb2trace.h"
+#include "fb2utils.h"
+
+//---------------------------------------------------------------------------
+//  FbSearchIndex
+//---------------------------------------------------------------------------
+
+static QList<int> intersect(const QList<int> &a, const QList<int> &b)
+{
+    QList<int> result;
+    int i = 0, j = 0;
+    while (i < a.count() && j < b.count()) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            result << a[i];
+            i++; j++;
+        }
+    }
+    return result;
+}
+
+static bool isBound(const QString &text, int pos)
+{
+    return pos < 0 || pos >= text.size() || !text.at(pos).isLetterOrNumber();
+}
+
+static bool hitLessThan(const FbSearchIndex::Hit &a, const FbSearchIndex::Hit &b)
+{
+    return a.count > b.count;
+}
+
+FbSearchIndex::FbSearchIndex(const QVariantList &data)
+{
+    for (int i = 0; i + 1 < data.count(); i += 2) {
+        m_ids << data.at(i).toInt();
+        m_texts << data.at(i + 1).toString();
+    }
+}
+
+QList<QStringRef> FbSearchIndex::words(const QString &text)
+{
+    QList<QStringRef> result;
+    int start = -1;
+    for (int i = 0; i <= text.size(); i++) {
+        bool letter = i < text.size() && text.at(i).isLetterOrNumber();
+        if (letter && start < 0) {
+            start = i;
+        } else if (!letter && start >= 0) {
+            result << text.midRef(start, i - start);
+            start = -1;
+        }
+    }
+    return result;
+}
+
+void FbSearchIndex::build()
+{
+    m_words.clear();
+    for (int row = 0; row < m_texts.count(); row++) {
+        const QString folded = m_texts.at(row).toCaseFolded();
+        foreach (const QStringRef &word, words(folded)) {
+            QList<int> &rows = m_words[word.toString()];
+            if (rows.isEmpty() || rows.last() != row) rows << row;
+        }
+    }
+}
+
+QList<FbSearchIndex::Hit> FbSearchIndex::search(const QString &text, Options options) const
+{
+    QList<Hit> hits;
+    if (text.isEmpty()) return hits;
+
+    const bool whole = options & WholeWords;
+    const QString folded = text.toCaseFolded();
+    FbSearchMatcher matcher(text, options);
+    if (!matcher.isValid()) return hits;
+
+    // Words entirely inside the query must occur as whole words
+    QList<int> rows;
+    bool all = true;
+    if (!(options & RegExp)) {
+        foreach (const QStringRef &word, words(folded)) {
+            bool inner = word.position() > 0 && word.position() + word.size() < folded.size();
+            if (!inner && !whole) continue;
+            const QList<int> list = m_words.value(word.toString());
+            rows = all ? list : intersect(rows, list);
+            all = false;
+            if (rows.isEmpty()) return hits;
+        }
+    }
+    if (all) {
+        for (int row = 0; row < m_texts.count(); row++) rows << row;
+    }
+
+    foreach (int row, rows) {
+        int count = matcher.count(m_texts.at(row));
+        if (count) {
+            Hit hit;
+            hit.row = row;
+            hit.count = count;
+            hits << hit;
+        }
+    }
+
+    qStableSort(hits.begin(), hits.end(), hitLessThan);
+    return hits;
+}
+
+//---------------------------------------------------------------------------
+//  FbSearchMatcher
+//---------------------------------------------------------------------------
+
+// Search counts and Replace All go through the same matcher, so the dock
+// never promises hits that replacing would not change
+FbSearchMatcher::FbSearchMatcher(const QString &text, FbSearchIndex::Options options)
+    : m_text(text)
+    , m_options(options)
+    , m_rx(text, (options & FbSearchIndex::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive, QRegExp::RegExp2)
+    , m_length(0)
+{
+}
+
+bool FbSearchMatcher::isValid() const
+{
+    if (m_text.isEmpty()) return false;
+    return !(m_options & FbSearchIndex::RegExp) || m_rx.isValid();
+}
+
+// Whole words are bounded by anything but a letter or a digit, in both modes
+int FbSearchMatcher::indexIn(const QString &text, int from)
+{
+    const bool regexp = m_options & FbSearchIndex::RegExp;
+    const Qt::CaseSensitivity cs = (m_options & FbSearchIndex::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    for (int pos = from; pos <= text.size(); pos++) {
+        if (regexp) {
+            pos = m_rx.indexIn(text, pos);
+            m_length = m_rx.matchedLength();
+        } else {
+            pos = text.indexOf(m_text, pos, cs);
+            m_length = m_text.size();
+        }
+        if (pos < 0) return -1;
+        if (!(m_options & FbSearchIndex::WholeWords)) return pos;
+        if (isBound(text, pos - 1) && isBound(text, pos + m_length)) return pos;
+    }
+    return -1;
+}
+
+int FbSearchMatcher::count(const QString &text)
+{
+    int count = 0;
+    int pos = indexIn(text, 0);
+    while (pos >= 0) {
+        count++;
+        pos = indexIn(text, pos + qMax(m_length, 1));
+    }
+    return count;
+}
+
+int FbSearchMatcher::replace(QString &text, const QString &after)
+{
+    QString result;
+    int count = 0;
+    int last = 0;
+    int pos = indexIn(text, 0);
+    while (pos >= 0) {
+        result += text.midRef(last, pos - last);
+        if (m_options & FbSearchIndex::RegExp) {
+            QString value = after;
+            for (int i = m_rx.captureCount(); i > 0; i--) {
+                value.replace(QString("\\%1").arg(i), m_rx.cap(i));
+            }
+            result += value;
+        } else {
+            result += after;
+        }
+        count++;
+        last = pos + m_length;
+        pos = indexIn(text, last + (m_length ? 0 : 1));
+    }
+    if (count) {
+        result += text.midRef(last);
+        text = result;
+    }
+    return count;
+}
+
+//---------------------------------------------------------------------------
+//  FbSearchThread
+//---------------------------------------------------------------------------
+
+void FbSearchThread::execute(QObject *parent, FbSearchIndexPtr index)
+{
+    FbSearchThread *thread = new FbSearchThread(index);
+    connect(thread, SIGNAL(finished()), parent, SLOT(indexed()));
+    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+    thread->start();
+}
+
+FbSearchThread::FbSearchThread(FbSearchIndexPtr index)
+    : QThread()
+    , m_index(index)
+{
+}
+
+void FbSearchThread::run()
+{
+    m_index->build();
+}
+
+//---------------------------------------------------------------------------
+//  FbSearchModel
+//---------------------------------------------------------------------------
+
+FbSearchModel::FbSearchModel(FbSearchIndexPtr index, const QList<FbSearchIndex::Hit> &hits, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_index(index)
+    , m_hits(hits)
+{
+}
+
+int FbSearchModel::id(const QModelIndex &index) const
+{
+    int row = index.row();
+    if (!m_index || row < 0 || row >= m_hits.count()) return 0;
+    return m_index->id(m_hits.at(row).row);
+}
+
+int FbSearchModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 2;
+}
+
+int FbSearchModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_hits.count();
+}
+
+QVariant FbSearchModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+            case 0: return tr("Text");
+            case 1: return tr("Hits");
+        }
+    }
+    return QVariant();
+}
+
+QVariant FbSearchModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || !m_index) return QVariant();
+    int row = index.row();
+    if (row < 0 || row >= m_hits.count()) return QVariant();
+
+    const FbSearchIndex::Hit &hit = m_hits.at(row);
+    switch (role) {
+        case Qt::DisplayRole: {
+            switch (index.column()) {
+                case 0: return m_index->text(hit.row).left(255).simplified();
+                case 1: return hit.count;
+            }
+        } break;
+        case Qt::TextAlignmentRole: {
+            return index.column() ? Qt::AlignRight : Qt::AlignLeft;
+        }
+    }
+    return QVariant();
+}
+
+//---------------------------------------------------------------------------
+//  FbSearchWidget
+//---------------------------------------------------------------------------
+
+FbSearchWidget::FbSearchWidget(FbTextEdit *text, QWidget* parent)
+    : QWidget(parent)
+    , m_text(text)
+    , m_reindex(false)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setSpacing(4);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_edit = new QLineEdit(this);
+    layout->addWidget(m_edit);
+
+    QHBoxLayout *options = new QHBoxLayout;
+    m_case = new QCheckBox(tr("&Case sensitive"), this);
+    options->addWidget(m_case);
+    m_words = new QCheckBox(tr("Complete &words"), this);
+    options->addWidget(m_words);
+    m_regexp = new QCheckBox(tr("Regular e&xpression"), this);
+    options->addWidget(m_regexp);
+    options->addStretch();
+    layout->addLayout(options);
+
+    m_replaceBox = new QWidget(this);
+    QHBoxLayout *replace = new QHBoxLayout(m_replaceBox);
+    replace->setContentsMargins(0, 0, 0, 0);
+    QLabel *label = new QLabel(tr("&Replace with:"), m_replaceBox);
+    replace->addWidget(label);
+    m_replace = new QLineEdit(m_replaceBox);
+    label->setBuddy(m_replace);
+    replace->addWidget(m_replace);
+    QPushButton *button = new QPushButton(tr("Replace &all"), m_replaceBox);
+    replace->addWidget(button);
+    m_replaceBox->hide();
+    layout->addWidget(m_replaceBox);
+
+    m_status = new QLabel(this);
+    layout->addWidget(m_status);
+
+    m_list = new QTreeView(this);
+    m_list->setRootIsDecorated(false);
+    m_list->setUniformRowHeights(true);
+    m_list->header()->setStretchLastSection(false);
+    m_list->header()->setResizeMode(QHeaderView::ResizeToContents);
+    layout->addWidget(m_list);
+
+    m_timer.setInterval(1000);
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), SLOT(rebuild()));
+
+    m_query.setInterval(250);
+    m_query.setSingleShot(true);
+    connect(&m_query, SIGNAL(timeout()), SLOT(search()));
+
+    connect(m_edit, SIGNAL(textChanged(QString)), &m_query, SLOT(start()));
+    connect(m_edit, SIGNAL(returnPressed()), SLOT(search()));
+    connect(m_case, SIGNAL(toggled(bool)), SLOT(search()));
+    connect(m_words, SIGNAL(toggled(bool)), SLOT(search()));
+    connect(m_regexp, SIGNAL(toggled(bool)), SLOT(search()));
+    connect(m_list, SIGNAL(activated(QModelIndex)), SLOT(activated(QModelIndex)));
+    connect(m_replace, SIGNAL(returnPressed()), SLOT(replaceAll()));
+    connect(button, SIGNAL(clicked()), SLOT(replaceAll()));
+    connect(m_text, SIGNAL(loadFinished(bool)), SLOT(loadFinished()));
+    loadFinished();
+}
+
+void FbSearchWidget::activate(const QString &text, bool replace)
+{
+    if (!text.isEmpty()) m_edit->setText(text);
+    m_edit->selectAll();
+    m_edit->setFocus();
+    if (replace) m_replaceBox->show();
+}
+
+FbSearchIndex::Options FbSearchWidget::options() const
+{
+    FbSearchIndex::Options result = 0;
+    if (m_case->isChecked()) result |= FbSearchIndex::CaseSensitive;
+    if (m_words->isChecked()) result |= FbSearchIndex::WholeWords;
+    if (m_regexp->isChecked()) result |= FbSearchIndex::RegExp;
+    return result;
+}
+
+void FbSearchWidget::loadFinished()
+{
+    connect(m_text->page(), SIGNAL(contentsChanged()), &m_timer, SLOT(start()), Qt::UniqueConnection);
+    m_index.clear();
+    search();
+    rebuild();
+}
+
+void FbSearchWidget::rebuild()
+{
+    if (m_building) {
+        m_reindex = true;
+        return;
+    }
+    FB2_TRACE("js:fbParagraphs");
+    QVariant data = m_text->page()->mainFrame()->evaluateJavaScript("fbParagraphs()");
+    m_building = FbSearchIndexPtr(new FbSearchIndex(data.toList()));
+    FbSearchThread::execute(this, m_building);
+}
+
+void FbSearchWidget::indexed()
+{
+    m_index = m_building;
+    m_building.clear();
+    if (m_reindex) {
+        m_reindex = false;
+        rebuild();
+    }
+    if (!m_edit->text().isEmpty()) search();
+}
+
+void FbSearchWidget::search()
+{
+    m_query.stop();
+    const QString text = m_edit->text();
+    const FbSearchIndex::Options options = this->options();
+
+    QList<FbSearchIndex::Hit> hits;
+    if (m_index) hits = m_index->search(text, options);
+
+    QAbstractItemModel *model = m_list->model();
+    m_list->setModel(new FbSearchModel(m_index, hits, this));
+    if (model) model->deleteLater();
+
+    int total = 0;
+    foreach (const FbSearchIndex::Hit &hit, hits) total += hit.count;
+
+    if (!m_index) {
+        m_status->setText(tr("Indexing..."));
+    } else if (text.isEmpty()) {
+        m_status->clear();
+    } else if (!FbSearchMatcher(text, options).isValid()) {
+        m_status->setText(tr("Invalid regular expression"));
+    } else {
+        m_status->setText(tr("%1 matches in %2 paragraphs").arg(total).arg(hits.count()));
+    }
+}
+
+void FbSearchWidget::replaceAll()
+{
+    const QString text = m_edit->text();
+    if (text.isEmpty()) return;
+
+    const FbSearchIndex::Options options = this->options();
+    FbSearchMatcher matcher(text, options);
+    if (!matcher.isValid()) {
+        m_status->setText(tr("Invalid regular expression"));
+        return;
+    }
+
+    // A stale index would miss paragraphs edited since the last build
+    QWebFrame *frame = m_text->page()->mainFrame();
+    FbSearchIndexPtr index = m_index;
+    if (!index || m_building || m_timer.isActive()) {
+        m_timer.stop();
+        index = FbSearchIndexPtr(new FbSearchIndex(frame->evaluateJavaScript("fbParagraphs()").toList()));
+        index->build();
+        if (!m_building) m_index = index;
+    }
+
+    QStringList ids;
+    foreach (const FbSearchIndex::Hit &hit, index->search(text, options)) {
+        ids << QString::number(index->id(hit.row));
+    }
+
+    QString changes;
+    int total = 0;
+    int bytes = 0;
+    if (!ids.isEmpty()) {
+        QVariantList texts = frame->evaluateJavaScript("fbTexts([" + ids.join(",") + "])").toList();
+        for (int i = 0; i < texts.count(); i++) {
+            QString data = texts.at(i).toString();
+            const int size = data.size();
+            int count = matcher.replace(data, m_replace->text());
+            if (!count) continue;
+            total += count;
+            bytes += (size + data.size()) * 2;
+            if (!changes.isEmpty()) changes += ',';
+            changes += QString::number(i) + ',' + jsString(data);
+        }
+    }
+
+    if (!total) {
+        m_status->setText(tr("No matches found"));
+        return;
+    }
+
+    int edit = frame->evaluateJavaScript("fbReplace([" + changes + "])").toInt();
+    m_text->page()->push(new FbReplaceTextCmd(frame, edit, bytes), tr("Replace all"));
+    m_status->setText(tr("%1 occurrences replaced").arg(total));
+    m_timer.start();
+}
+
+void FbSearchWidget::activated(const QModelIndex &index)
+{
+    FbSearchModel *model = qobject_cast<FbSearchModel*>(m_list->model());
+    if (!model) return;
+
+    QString javascript = QString("fbSelect(%1)").arg(model->id(index));
+    if (!m_text->page()->mainFrame()->evaluateJavaScript(javascript).toBool()) {
+        m_status->setText(tr("The paragraph has been removed"));
+        return;
+    }
+
+    // Select only the current hit instead of highlighting the whole book
+    if (!(options() & FbSearchIndex::RegExp)) {
+        QWebPage::FindFlags flags = 0;
+        if (m_case->isChecked()) flags |= QWebPage::FindCaseSensitively;
+        m_text->findText(m_edit->text(), flags);
+    }
+    m_text->setFocus();
+}
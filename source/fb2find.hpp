@@ -0,0 +1,148 @@
+#ifndef FB2FIND_H
+#define FB2FIND_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QList>
+#include <QRegExp>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QVariant>
+#include <QWidget>
+
+QT_BEGIN_NAMESPACE
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QTreeView;
+QT_END_NAMESPACE
+
+class FbTextEdit;
+
+class FbSearchIndex
+{
+public:
+    enum Option {
+        CaseSensitive = 0x1,
+        RegExp        = 0x2,
+        WholeWords    = 0x4,
+    };
+    Q_DECLARE_FLAGS(Options, Option)
+
+    struct Hit {
+        int row;
+        int count;
+    };
+
+    explicit FbSearchIndex(const QVariantList &data);
+    void build();
+    QList<Hit> search(const QString &text, Options options) const;
+    int count() const { return m_ids.count(); }
+    int id(int row) const { return m_ids.at(row); }
+    const QString & text(int row) const { return m_texts.at(row); }
+
+private:
+    static QList<QStringRef> words(const QString &text);
+
+private:
+    QList<int> m_ids;
+    QStringList m_texts;
+    QHash<QString, QList<int> > m_words;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(FbSearchIndex::Options)
+
+class FbSearchMatcher
+{
+public:
+    explicit FbSearchMatcher(const QString &text, FbSearchIndex::Options options);
+    bool isValid() const;
+    int indexIn(const QString &text, int from);
+    int count(const QString &text);
+    int replace(QString &text, const QString &after);
+
+private:
+    const QString m_text;
+    const FbSearchIndex::Options m_options;
+    QRegExp m_rx;
+    int m_length;
+};
+
+typedef QSharedPointer<FbSearchIndex> FbSearchIndexPtr;
+
+class FbSearchThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    static void execute(QObject *parent, FbSearchIndexPtr index);
+
+protected:
+    void run();
+
+private:
+    explicit FbSearchThread(FbSearchIndexPtr index);
+
+private:
+    FbSearchIndexPtr m_index;
+};
+
+class FbSearchModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit FbSearchModel(FbSearchIndexPtr index, const QList<FbSearchIndex::Hit> &hits, QObject *parent = 0);
+    int id(const QModelIndex &index) const;
+
+public:
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+
+private:
+    FbSearchIndexPtr m_index;
+    QList<FbSearchIndex::Hit> m_hits;
+};
+
+class FbSearchWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FbSearchWidget(FbTextEdit *text, QWidget* parent = 0);
+    void activate(const QString &text, bool replace = false);
+
+private slots:
+    void loadFinished();
+    void rebuild();
+    void indexed();
+    void search();
+    void replaceAll();
+    void activated(const QModelIndex &index);
+
+private:
+    FbSearchIndex::Options options() const;
+
+private:
+    FbTextEdit *m_text;
+    QLineEdit *m_edit;
+    QWidget *m_replaceBox;
+    QLineEdit *m_replace;
+    QCheckBox *m_case;
+    QCheckBox *m_regexp;
+    QCheckBox *m_words;
+    QLabel *m_status;
+    QTreeView *m_list;
+    QTimer m_timer;
+    QTimer m_query;
+    FbSearchIndexPtr m_index;
+    FbSearchIndexPtr m_building;
+    bool m_reindex;
+};
+
+#endif // FB2FIND_H
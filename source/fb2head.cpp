@@ -4,6 +4,8 @@
 #include <QAction>
 #include <QComboBox>
 #include <QDialogButtonBox>
+#include <QDomDocument>
+#include <QFile>
 #include <QFormLayout>
 #include <QGridLayout>
 #include <QHeaderView>
@@ -15,167 +17,257 @@
 #include <QWebView>
 #include <QItemDelegate>
 #include <QTreeView>
+#include <QVector>
 
 #include "fb2text.hpp"
 #include "fb2utils.h"
 
 //---------------------------------------------------------------------------
-//  FbScheme::Fb
+//  FbScheme::Table
 //---------------------------------------------------------------------------
 
-FbScheme::FbDom::FbDom()
+// The schema is compiled once into flat nodes; lookups never touch the DOM
+class FbScheme::Table
 {
+public:
+    struct Node {
+        Keyword kind;
+        QString name;
+        QString type;
+        QString info;
+        QString min;
+        QString max;
+        QList<int> children;
+        QHash<QString, int> lookup;
+        QStringList items;
+        bool canEdit;
+    };
+
+    explicit Table();
+    int element(int index, const QString &name);
+
+    QVector<Node> nodes;
+    QHash<QString, int> types;
+    int root;
+
+private:
+    int append(const QDomElement &element);
+    int item(int index, const QString &name) const;
+    int typeScheme(int index);
+    void items(int index, QStringList &list) const;
+    bool canEdit(int index);
+};
+
+FbScheme::Table::Table()
+    : root(-1)
+{
+    QDomDocument doc;
     QFile file(":/fb2/FictionBook2.1.xsd");
-    if (file.open(QIODevice::ReadOnly)) setContent(&file);
-}
+    if (file.open(QIODevice::ReadOnly)) doc.setContent(&file);
 
-//---------------------------------------------------------------------------
-//  FbScheme
-//---------------------------------------------------------------------------
+    QDomElement schema = doc.documentElement();
+    if (schema.isNull()) return;
+    int index = append(schema);
 
-const QDomDocument & FbScheme::fb2()
-{
-    static const FbDom doc;
-    return doc;
-}
+    foreach (int child, nodes[index].children) {
+        const Node &node = nodes[child];
+        if (node.kind == XsComplexType && !types.contains(node.name)) types.insert(node.name, child);
+    }
+    root = item(index, "FictionBook");
 
-FB2_BEGIN_KEYHASH(FbScheme)
-    FB2_KEY( XsElement     , "xs:element"     );
-    FB2_KEY( XsChoice      , "xs:choice"      );
-    FB2_KEY( XsComplexType , "xs:complexType" );
-    FB2_KEY( XsSequence    , "xs:sequence"    );
-FB2_END_KEYHASH
+    for (int i = 0; i < nodes.size(); i++) {
+        int scheme = typeScheme(i);
+        if (scheme >= 0) items(scheme, nodes[i].items);
+    }
+    for (int i = 0; i < nodes.size(); i++) {
+        nodes[i].canEdit = canEdit(i);
+    }
+}
 
-void FbScheme::items(QStringList &list) const
+int FbScheme::Table::append(const QDomElement &element)
 {
-    FbScheme child = typeScheme().firstChildElement();
+    int index = nodes.size();
+    nodes.resize(index + 1);
+    {
+        Node &node = nodes[index];
+        node.kind = toKeyword(element.tagName());
+        node.name = element.attribute("name");
+        node.min = element.attribute("minOccurs");
+        node.max = element.attribute("maxOccurs");
+        node.info = element.firstChildElement("xs:annotation").firstChildElement("xs:documentation").text();
+        node.canEdit = false;
+        node.type = element.attribute("type");
+        if (node.type.isEmpty()) {
+            QDomElement child = element.firstChildElement("xs:complexType").firstChildElement();
+            while (!child.isNull()) {
+                QString tag = child.tagName();
+                if (tag == "xs:complexContent" || tag == "xs:simpleContent") {
+                    node.type = child.firstChildElement("xs:extension").attribute("base");
+                    break;
+                }
+                child = child.nextSiblingElement();
+            }
+        }
+    }
+
+    QDomElement child = element.firstChildElement();
     while (!child.isNull()) {
         switch (toKeyword(child.tagName())) {
-            case XsElement: {
-                    QString name = child.attribute("name");
-                    if (!list.contains(name)) list << name;
-                } break;
+            case XsElement:
             case XsChoice:
             case XsComplexType:
             case XsSequence: {
-                    child.items(list);
+                    int n = append(child);
+                    nodes[index].children << n;
                 } break;
             default: ;
         }
         child = child.nextSiblingElement();
     }
+
+    return index;
 }
 
-bool FbScheme::canEdit() const
+int FbScheme::Table::item(int index, const QString &name) const
 {
-    if (type() == "sequenceType") return true;
-    FbScheme scheme = typeScheme();
-    FbScheme child = scheme.firstChildElement();
-    while (!child.isNull()) {
-        switch (toKeyword(child.tagName())) {
-            case XsElement:
-                return false;
+    foreach (int child, nodes[index].children) {
+        const Node &node = nodes[child];
+        switch (node.kind) {
+            case XsElement: {
+                    if (node.name == name) return child;
+                } break;
             case XsChoice:
             case XsComplexType:
-            case XsSequence:
-                if (!child.canEdit()) return false;
+            case XsSequence: {
+                    int result = item(child, name);
+                    if (result >= 0) return result;
+                } break;
             default: ;
         }
-        child = child.nextSiblingElement();
     }
-    return true;
+    return -1;
 }
 
-FbScheme FbScheme::typeScheme() const
+int FbScheme::Table::element(int index, const QString &name)
 {
-    QString typeName = type();
-    if (typeName.isEmpty()) return *this;
+    int parent = index < 0 ? root : index;
+    if (parent < 0) return -1;
 
-    FbScheme child = fb2().firstChildElement("xs:schema").firstChildElement();
-    while (!child.isNull()) {
-        if (child.tagName() == "xs:complexType") {
-            if (child.attribute("name") == typeName) return child.element(typeName);
+    QHash<QString, int>::const_iterator it = nodes[parent].lookup.constFind(name);
+    if (it != nodes[parent].lookup.constEnd() && index >= 0) return it.value();
+
+    int result = item(parent, name);
+    if (result < 0 && index >= 0) {
+        const QString type = nodes[index].type;
+        if (type.isEmpty()) {
+            result = index;
+        } else {
+            int scheme = types.value(type, -1);
+            if (scheme >= 0) result = element(scheme, name);
         }
-        child = child.nextSiblingElement();
     }
-
-    return FbScheme();
+    if (index >= 0) nodes[index].lookup.insert(name, result);
+    return result;
 }
 
-QString FbScheme::info() const
+int FbScheme::Table::typeScheme(int index)
 {
-    QDomElement element = *this;
-    if (element.isNull()) return QString();
-
-    element = element.firstChildElement("xs:annotation");
-    if (element.isNull()) return QString();
-
-    element = element.firstChildElement("xs:documentation");
-    if (element.isNull()) return QString();
-
-    return element.text();
+    const QString type = nodes[index].type;
+    if (type.isEmpty()) return index;
+    int scheme = types.value(type, -1);
+    return scheme < 0 ? -1 : element(scheme, type);
 }
 
-QString FbScheme::type() const
+void FbScheme::Table::items(int index, QStringList &list) const
 {
-    if (isNull()) return QString();
-    QString result = attribute("type");
-    if (!result.isEmpty()) return result;
-    FbScheme child = firstChildElement("xs:complexType").firstChildElement();
-    while (!child.isNull()) {
-        QString tag = child.tagName();
-        if (tag == "xs:complexContent" || tag == "xs:simpleContent") {
-            return child.firstChildElement("xs:extension").attribute("base");
+    foreach (int child, nodes[index].children) {
+        const Node &node = nodes[child];
+        switch (node.kind) {
+            case XsElement: {
+                    if (!list.contains(node.name)) list << node.name;
+                } break;
+            case XsChoice:
+            case XsComplexType:
+            case XsSequence: {
+                    items(child, list);
+                } break;
+            default: ;
         }
-        child = child.nextSiblingElement();
     }
-    return QString();
 }
 
-FbScheme FbScheme::item(const QString &name) const
+bool FbScheme::Table::canEdit(int index)
 {
-    FbScheme child = firstChildElement();
-    while (!child.isNull()) {
-        switch (toKeyword(child.tagName())) {
-            case XsElement: {
-                    if (child.attribute("name") == name) return child;
-                } break;
+    if (nodes[index].type == "sequenceType") return true;
+    int scheme = typeScheme(index);
+    if (scheme < 0) return true;
+    foreach (int child, nodes[scheme].children) {
+        switch (nodes[child].kind) {
+            case XsElement:
+                return false;
             case XsChoice:
             case XsComplexType:
-            case XsSequence: {
-                    FbScheme result = child.item(name);
-                    if (!result.isNull()) return result;
-                } break;
+            case XsSequence:
+                if (!canEdit(child)) return false;
             default: ;
         }
-        child = child.nextSiblingElement();
     }
-    return FbScheme();
+    return true;
+}
+
+//---------------------------------------------------------------------------
+//  FbScheme
+//---------------------------------------------------------------------------
+
+FB2_BEGIN_KEYHASH(FbScheme)
+    FB2_KEY( XsElement     , "xs:element"     );
+    FB2_KEY( XsChoice      , "xs:choice"      );
+    FB2_KEY( XsComplexType , "xs:complexType" );
+    FB2_KEY( XsSequence    , "xs:sequence"    );
+FB2_END_KEYHASH
+
+FbScheme::Table & FbScheme::table()
+{
+    static Table table;
+    return table;
 }
 
 FbScheme FbScheme::element(const QString &name) const
 {
-    FbScheme parent = *this;
-    if (parent.isNull()) {
-        parent = fb2().documentElement();
-        parent = parent.element("FictionBook");
+    return FbScheme(table().element(m_index, name));
+}
+
+void FbScheme::items(QStringList &list) const
+{
+    if (isNull()) return;
+    foreach (const QString &name, table().nodes[m_index].items) {
+        if (!list.contains(name)) list << name;
     }
+}
+
+bool FbScheme::canEdit() const
+{
+    return isNull() || table().nodes[m_index].canEdit;
+}
 
-    FbScheme child = parent.item(name);
-    if (!child.isNull()) return child;
+QString FbScheme::info() const
+{
+    return isNull() ? QString() : table().nodes[m_index].info;
+}
 
-    QString type = this->type();
-    if (type.isEmpty()) return *this;
+QString FbScheme::type() const
+{
+    return isNull() ? QString() : table().nodes[m_index].type;
+}
 
-    child = fb2().firstChildElement("xs:schema").firstChildElement();
-    while (!child.isNull()) {
-        if (child.tagName() == "xs:complexType") {
-            if (child.attribute("name") == type) return child.element(name);
-        }
-        child = child.nextSiblingElement();
-    }
+QString FbScheme::minOccurs() const
+{
+    return isNull() ? QString() : table().nodes[m_index].min;
+}
 
-    return FbScheme();
+QString FbScheme::maxOccurs() const
+{
+    return isNull() ? QString() : table().nodes[m_index].max;
 }
 
 //---------------------------------------------------------------------------
@@ -221,11 +313,11 @@ FbHeadItem::FbHeadItem(QWebElement &element, FbHeadItem *parent)
     m_name = element.tagName().toLower();
     if (m_name.left(3) == "fb:") {
         m_name = m_name.mid(3);
-        if (m_name == "annotation") return;
-        if (m_name == "history") return;
     } else if (m_name == "img") {
         m_name = "image";
     }
+    m_scheme = parent ? parent->m_scheme.element(m_name) : FbScheme().element(m_name);
+    if (m_name == "annotation" || m_name == "history") return;
     addChildren(element);
 }
 
@@ -249,21 +341,49 @@ FbHeadItem * FbHeadItem::append(const QString name)
 }
 
 void FbHeadItem::addChildren(QWebElement &parent)
+{
+    QList<QWebElement> list;
+    addElements(parent, list);
+    for (int i = 0; i < list.size(); i++) {
+        m_list << new FbHeadItem(list[i], this);
+    }
+}
+
+void FbHeadItem::addElements(const QWebElement &parent, QList<QWebElement> &list)
 {
     QWebElement child = parent.firstChild();
     while (!child.isNull()) {
         QString tag = child.tagName().toLower();
         if (tag.left(3) == "fb:") {
-            m_list << new FbHeadItem(child, this);
+            list << child;
         } else if (tag == "img") {
-            m_list << new FbHeadItem(child, this);
+            list << child;
         } else {
-            addChildren(child);
+            addElements(child, list);
         }
         child = child.nextSibling();
     }
 }
 
+QList<QWebElement> FbHeadItem::children() const
+{
+    QList<QWebElement> list;
+    if (m_name == "annotation" || m_name == "history") return list;
+    addElements(m_element, list);
+    return list;
+}
+
+void FbHeadItem::insert(int row, QWebElement &element)
+{
+    m_list.insert(row, new FbHeadItem(element, this));
+}
+
+void FbHeadItem::take(int row)
+{
+    if (row < 0 || row >= count()) return;
+    delete m_list.takeAt(row);
+}
+
 FbHeadItem * FbHeadItem::item(const QModelIndex &index) const
 {
     int row = index.row();
@@ -283,11 +403,11 @@ QString FbHeadItem::data(int col) const
         case 0: return QString("<%1> %2").arg(m_name).arg(hint());
         case 1: return value();
         case 2: return extra();
-        case 3: return scheme().info();
-        case 4: return scheme().type();
-        case 5: return scheme().canEdit() ? "Yes" : "No";
-        case 6: return scheme().attribute("minOccurs");
-        case 7: return scheme().attribute("maxOccurs");
+        case 3: return m_scheme.info();
+        case 4: return m_scheme.type();
+        case 5: return m_scheme.canEdit() ? "Yes" : "No";
+        case 6: return m_scheme.minOccurs();
+        case 7: return m_scheme.maxOccurs();
     }
     return QString();
 }
@@ -387,12 +507,6 @@ QString FbHeadItem::sub(const QString &key) const
     return QString();
 }
 
-FbScheme FbHeadItem::scheme() const
-{
-    FbScheme parent = m_parent ? m_parent->scheme() : FbScheme();
-    return parent.element(m_name);
-}
-
 void FbHeadItem::remove(int row)
 {
     if (row < 0 || row >= count()) return;
@@ -409,12 +523,69 @@ FbHeadModel::FbHeadModel(QWebView &view, QObject *parent)
     , m_view(view)
     , m_root(NULL)
 {
-    QWebElement doc = view.page()->mainFrame()->documentElement();
-    QWebElement head = doc.findFirst("fb\\:description");
+    QWebElement head = description(view);
     if (head.isNull()) return;
     m_root = new FbHeadItem(head);
 }
 
+QWebElement FbHeadModel::description(QWebView &view)
+{
+    QWebElement doc = view.page()->mainFrame()->documentElement();
+    return doc.findFirst("fb\\:description");
+}
+
+void FbHeadModel::update()
+{
+    QWebElement head = description(m_view);
+    if (!m_root || head != m_root->element()) {
+        beginResetModel();
+        if (m_root) delete m_root;
+        m_root = head.isNull() ? NULL : new FbHeadItem(head);
+        endResetModel();
+        return;
+    }
+    QModelIndex index = createIndex(0, 0, (void*)m_root);
+    emit dataChanged(index, this->index(0, columnCount() - 1));
+    update(index, m_root);
+}
+
+void FbHeadModel::update(const QModelIndex &index, FbHeadItem *owner)
+{
+    QList<QWebElement> list = owner->children();
+
+    for (int row = 0; row < list.size(); row++) {
+        QWebElement &element = list[row];
+        int found = -1;
+        for (int i = row; i < owner->count(); i++) {
+            if (owner->item(i)->element() == element) { found = i; break; }
+        }
+        if (found > row) {
+            beginRemoveRows(index, row, found - 1);
+            for (int i = found - 1; i >= row; i--) owner->take(i);
+            endRemoveRows();
+        } else if (found < 0) {
+            beginInsertRows(index, row, row);
+            owner->insert(row, element);
+            endInsertRows();
+            continue;
+        }
+        update(this->index(row, 0, index), owner->item(row));
+    }
+
+    int count = owner->count();
+    if (count > list.size()) {
+        beginRemoveRows(index, list.size(), count - 1);
+        for (int i = count - 1; i >= list.size(); i--) owner->take(i);
+        endRemoveRows();
+    }
+
+    if (list.size()) {
+        QModelIndex first = this->index(0, 0, index);
+        QModelIndex last = this->index(list.size() - 1, columnCount() - 1, index);
+        emit dataChanged(first, last);
+    }
+}
+
 FbHeadModel::~FbHeadModel()
 {
     if (m_root) delete m_root;
@@ -615,9 +786,12 @@ FbHeadModel * FbHeadEdit::model() const
 
 void FbHeadEdit::updateTree()
 {
-    FbHeadModel * model = new FbHeadModel(*m_text, this);
-    setModel(model);
-    model->expand(this);
+    if (FbHeadModel * m = model()) {
+        m->update();
+    } else {
+        setModel(new FbHeadModel(*m_text, this));
+    }
+    model()->expand(this);
 }
 
 void FbHeadEdit::editCurrent(const QModelIndex &index)
@@ -3,8 +3,6 @@
 
 #include <QAbstractItemModel>
 #include <QDialog>
-#include <QDomDocument>
-#include <QDomElement>
 #include <QMap>
 #include <QTreeView>
 #include <QWebElement>
@@ -24,7 +22,7 @@ QT_END_NAMESPACE
 
 class FbTextEdit;
 
-class FbScheme : public QDomElement
+class FbScheme
 {
     FB2_BEGIN_KEYLIST
         XsElement,
@@ -34,29 +32,24 @@ class FbScheme : public QDomElement
     FB2_END_KEYLIST
 
 private:
-    class FbDom : public QDomDocument { public: FbDom(); };
+    class Table;
 
 public:
-    FbScheme() {}
-    FbScheme(const FbScheme &x) : QDomElement(x) {}
-    FbScheme(const QDomElement &x) : QDomElement(x) {}
-    FbScheme& operator=(const FbScheme &x) { QDomElement::operator=(x); return *this; }
+    FbScheme() : m_index(-1) {}
 
-    void setAction(Fb::Actions index, QAction *action);
-    void connectActions();
-    void disconnectActions();
-
-    static const QDomDocument & fb2();
+    bool isNull() const { return m_index < 0; }
     FbScheme element(const QString &name) const;
     void items(QStringList &list) const;
     bool canEdit() const;
     QString info() const;
     QString type() const;
+    QString minOccurs() const;
+    QString maxOccurs() const;
 
 private:
-    FbScheme typeScheme() const;
-    FbScheme item(const QString &name) const;
-    FbActionMap m_actions;
+    explicit FbScheme(int index) : m_index(index) {}
+    static Table & table();
+    int m_index;
 };
 
 class FbHeadItem: public QObject
@@ -81,6 +74,12 @@ public:
 
     void remove(int row);
 
+    void take(int row);
+
+    void insert(int row, QWebElement &element);
+
+    QList<QWebElement> children() const;
+
     FbHeadItem * item(const QModelIndex &index) const;
 
     FbHeadItem * item(int row) const;
@@ -111,10 +110,12 @@ public:
 
     QString sub(const QString &key) const;
 
-    FbScheme scheme() const;
+    const FbScheme & scheme() const {
+        return m_scheme;
+    }
 
     bool canEdit() const {
-        return scheme().canEdit();
+        return m_scheme.canEdit();
     }
 
     bool canEditExtra() const;
@@ -128,6 +129,7 @@ private:
 
 private:
     void addChildren(QWebElement &parent);
+    static void addElements(const QWebElement &parent, QList<QWebElement> &list);
     void setValue(const QString &text);
     void setExtra(const QString &text);
     QString value() const;
@@ -138,6 +140,7 @@ private:
     QList<FbHeadItem*> m_list;
     QWebElement m_element;
     FbHeadItem * m_parent;
+    FbScheme m_scheme;
     QString m_name;
 };
 
@@ -153,6 +156,7 @@ public:
     QModelIndex append(const QModelIndex &parent, const QString &name);
     bool canEdit(const QModelIndex &index) const;
     void remove(const QModelIndex &index);
+    void update();
 
 public:
     Qt::ItemFlags flags(const QModelIndex &index) const;
@@ -164,6 +168,10 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
 
+private:
+    static QWebElement description(QWebView &view);
+    void update(const QModelIndex &index, FbHeadItem *owner);
+
 private:
     QWebView & m_view;
     FbHeadItem * m_root;
@@ -221,7 +229,7 @@ private slots:
     void comboChanged(const QString &text);
 
 private:
-    const FbScheme &m_scheme;
+    const FbScheme m_scheme;
     QComboBox * m_combo;
     QLabel * m_text;
 };
@@ -234,7 +242,7 @@ public:
     explicit FbNodeEditDlg(QWidget *parent, const FbScheme &scheme, const QWebElement &element);
 
 private:
-    const FbScheme &m_scheme;
+    const FbScheme m_scheme;
     QWebElement m_element;
 };
 
@@ -0,0 +1,216 @@
+#include "fb2highlight.h"
+
+#include <QVarLengthArray>
+
+//---------------------------------------------------------------------------
+//  FbHighlighter
+//---------------------------------------------------------------------------
+
+static const QColor DEFAULT_SYNTAX_CHAR     = Qt::blue;
+static const QColor DEFAULT_ELEMENT_NAME    = Qt::darkRed;
+static const QColor DEFAULT_COMMENT         = Qt::darkGray;
+static const QColor DEFAULT_ATTRIBUTE_NAME  = Qt::red;
+static const QColor DEFAULT_ATTRIBUTE_VALUE = Qt::darkGreen;
+static const QColor DEFAULT_ERROR           = Qt::darkMagenta;
+static const QColor DEFAULT_OTHER           = Qt::black;
+
+#define S FbHighlighter::SyntaxChar
+#define E FbHighlighter::ElementName
+#define C FbHighlighter::Comment
+#define A FbHighlighter::AttributeName
+#define V FbHighlighter::AttributeValue
+#define X FbHighlighter::Error
+#define O FbHighlighter::Other
+
+//  Columns:  <  >  /  =  "  '  !  -  ?  Start  Name  Space  Other
+
+static const uchar lexerType[FbHighlighter::LexStateCount][FbHighlighter::ChClassCount] = {
+    { S, X, O, O, O, O, O, O, O, O, O, O, O }, // LexText
+    { X, S, S, X, X, X, S, X, S, E, X, X, X }, // LexOpen
+    { X, S, X, X, X, X, X, X, X, E, X, X, X }, // LexClose
+    { X, S, S, X, X, X, X, E, S, E, E, O, X }, // LexName
+    { X, S, S, X, X, X, X, X, S, A, X, O, X }, // LexTag
+    { X, S, S, O, X, X, X, A, S, A, A, O, X }, // LexAttr
+    { X, S, S, O, X, X, X, X, S, A, X, O, X }, // LexEqual
+    { X, S, X, X, O, O, X, X, X, X, X, O, X }, // LexValue
+    { X, V, V, V, O, V, V, V, V, V, V, V, V }, // LexValueDq
+    { X, V, V, V, V, O, V, V, V, V, V, V, V }, // LexValueSq
+    { X, S, X, X, X, X, X, S, X, E, X, X, X }, // LexBang
+    { X, S, X, X, X, X, X, S, X, X, X, X, X }, // LexBang1
+    { C, C, C, C, C, C, C, C, C, C, C, C, C }, // LexComment
+    { C, C, C, C, C, C, C, C, C, C, C, C, C }, // LexComment1
+    { C, S, C, C, C, C, C, C, C, C, C, C, C }, // LexComment2
+};
+
+#undef S
+#undef E
+#undef C
+#undef A
+#undef V
+#undef X
+#undef O
+
+#define T FbHighlighter::LexText
+#define P FbHighlighter::LexOpen
+#define L FbHighlighter::LexClose
+#define N FbHighlighter::LexName
+#define G FbHighlighter::LexTag
+#define A FbHighlighter::LexAttr
+#define Q FbHighlighter::LexEqual
+#define V FbHighlighter::LexValue
+#define D FbHighlighter::LexValueDq
+#define S FbHighlighter::LexValueSq
+#define B FbHighlighter::LexBang
+#define H FbHighlighter::LexBang1
+#define C FbHighlighter::LexComment
+#define M FbHighlighter::LexComment1
+#define K FbHighlighter::LexComment2
+
+static const uchar lexerNext[FbHighlighter::LexStateCount][FbHighlighter::ChClassCount] = {
+    { P, T, T, T, T, T, T, T, T, T, T, T, T }, // LexText
+    { P, T, L, G, G, G, B, G, L, N, G, G, G }, // LexOpen
+    { P, T, G, G, G, G, G, G, G, N, G, G, G }, // LexClose
+    { P, T, G, G, G, G, G, N, G, N, N, G, G }, // LexName
+    { P, T, G, G, G, G, G, G, G, A, G, G, G }, // LexTag
+    { P, T, G, V, G, G, G, A, G, A, A, Q, G }, // LexAttr
+    { P, T, G, V, G, G, G, G, G, A, G, Q, G }, // LexEqual
+    { P, T, G, G, D, S, G, G, G, G, G, V, G }, // LexValue
+    { D, D, D, D, G, D, D, D, D, D, D, D, D }, // LexValueDq
+    { S, S, S, S, S, G, S, S, S, S, S, S, S }, // LexValueSq
+    { P, T, G, G, G, G, G, H, G, N, G, G, G }, // LexBang
+    { P, T, G, G, G, G, G, C, G, G, G, G, G }, // LexBang1
+    { C, C, C, C, C, C, C, M, C, C, C, C, C }, // LexComment
+    { C, C, C, C, C, C, C, K, C, C, C, C, C }, // LexComment1
+    { C, T, C, C, C, C, C, K, C, C, C, C, C }, // LexComment2
+};
+
+#undef T
+#undef P
+#undef L
+#undef N
+#undef G
+#undef A
+#undef Q
+#undef V
+#undef D
+#undef S
+#undef B
+#undef H
+#undef C
+#undef M
+#undef K
+
+static const uchar * charClasses()
+{
+    static uchar table[0x80];
+    static bool ready = false;
+    if (ready) return table;
+
+    for (int c = 0; c < 0x80; ++c) {
+        uchar type = FbHighlighter::ChOther;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == ':') {
+            type = FbHighlighter::ChStart;
+        } else if ((c >= '0' && c <= '9') || c == '.') {
+            type = FbHighlighter::ChName;
+        } else switch (c) {
+            case '<' : type = FbHighlighter::ChLt; break;
+            case '>' : type = FbHighlighter::ChGt; break;
+            case '/' : type = FbHighlighter::ChSlash; break;
+            case '=' : type = FbHighlighter::ChEq; break;
+            case '"' : type = FbHighlighter::ChDq; break;
+            case '\'': type = FbHighlighter::ChSq; break;
+            case '!' : type = FbHighlighter::ChBang; break;
+            case '-' : type = FbHighlighter::ChDash; break;
+            case '?' : type = FbHighlighter::ChQuest; break;
+            case ' ' : case '\t': case '\r': case '\n':
+                type = FbHighlighter::ChSpace; break;
+        }
+        table[c] = type;
+    }
+    ready = true;
+    return table;
+}
+
+FbHighlighter::FbHighlighter(QObject* parent)
+    : QSyntaxHighlighter(parent)
+{
+    init();
+}
+
+FbHighlighter::FbHighlighter(QTextDocument* parent)
+    : QSyntaxHighlighter(parent)
+{
+    init();
+}
+
+FbHighlighter::FbHighlighter(QTextEdit* parent)
+    : QSyntaxHighlighter(parent)
+{
+    init();
+}
+
+FbHighlighter::~FbHighlighter()
+{
+}
+
+void FbHighlighter::init()
+{
+    m_formats[SyntaxChar].setForeground(DEFAULT_SYNTAX_CHAR);
+    m_formats[ElementName].setForeground(DEFAULT_ELEMENT_NAME);
+    m_formats[Comment].setForeground(DEFAULT_COMMENT);
+    m_formats[AttributeName].setForeground(DEFAULT_ATTRIBUTE_NAME);
+    m_formats[AttributeValue].setForeground(DEFAULT_ATTRIBUTE_VALUE);
+    m_formats[Error].setForeground(DEFAULT_ERROR);
+    m_formats[Other].setForeground(DEFAULT_OTHER);
+}
+
+void FbHighlighter::setHighlightColor(HighlightType type, QColor color, bool foreground)
+{
+    QTextCharFormat format;
+    if (foreground)
+        format.setForeground(color);
+    else
+        format.setBackground(color);
+    setHighlightFormat(type, format);
+}
+
+void FbHighlighter::setHighlightFormat(HighlightType type, QTextCharFormat format)
+{
+    if (type < 0 || type >= TypeCount) return;
+    m_formats[type] = format;
+    rehighlight();
+}
+
+void FbHighlighter::highlightBlock(const QString &text)
+{
+    const uchar *classes = charClasses();
+    const QChar *data = text.unicode();
+    const int length = text.length();
+
+    int state = previousBlockState();
+    if (state < 0 || state >= LexStateCount) state = LexText;
+
+    QVarLengthArray<uchar, 1024> types(length);
+    for (int i = 0; i < length; ++i) {
+        ushort c = data[i].unicode();
+        int type = c < 0x80 ? classes[c] : ChStart;
+        if (state == LexComment2 && type == ChGt && i > 1) {
+            types[i - 1] = types[i - 2] = SyntaxChar;
+        }
+        types[i] = lexerType[state][type];
+        state = lexerNext[state][type];
+    }
+
+    // The line break separates names like any other whitespace
+    if (state == LexName) state = LexTag;
+    if (state == LexAttr) state = LexEqual;
+    setCurrentBlockState(state);
+
+    int start = 0;
+    for (int i = 1; i <= length; ++i) {
+        if (i == length || types[i] != types[start]) {
+            setFormat(start, i - start, m_formats[types[start]]);
+            start = i;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef FB2HIGHLIGHT_H
+#define FB2HIGHLIGHT_H
+
+#include <QColor>
+#include <QSyntaxHighlighter>
+#include <QTextCharFormat>
+
+QT_BEGIN_NAMESPACE
+class QTextDocument;
+class QTextEdit;
+QT_END_NAMESPACE
+
+class FbHighlighter : public QSyntaxHighlighter
+{
+public:
+    FbHighlighter(QObject* parent);
+    FbHighlighter(QTextDocument* parent);
+    FbHighlighter(QTextEdit* parent);
+    ~FbHighlighter();
+
+    enum HighlightType
+    {
+        SyntaxChar,
+        ElementName,
+        Comment,
+        AttributeName,
+        AttributeValue,
+        Error,
+        Other,
+        TypeCount
+    };
+
+    enum LexerState
+    {
+        LexText,
+        LexOpen,
+        LexClose,
+        LexName,
+        LexTag,
+        LexAttr,
+        LexEqual,
+        LexValue,
+        LexValueDq,
+        LexValueSq,
+        LexBang,
+        LexBang1,
+        LexComment,
+        LexComment1,
+        LexComment2,
+        LexStateCount
+    };
+
+    enum CharClass
+    {
+        ChLt,
+        ChGt,
+        ChSlash,
+        ChEq,
+        ChDq,
+        ChSq,
+        ChBang,
+        ChDash,
+        ChQuest,
+        ChStart,
+        ChName,
+        ChSpace,
+        ChOther,
+        ChClassCount
+    };
+
+    void setHighlightColor(HighlightType type, QColor color, bool foreground = true);
+    void setHighlightFormat(HighlightType type, QTextCharFormat format);
+
+protected:
+    void highlightBlock(const QString &text);
+
+private:
+    void init();
+
+private:
+    QTextCharFormat m_formats[TypeCount];
+};
+
+#endif // FB2HIGHLIGHT_H
@@ -1,6 +1,9 @@
 #include "fb2html.h"
 #include "fb2utils.h"
 #include "fb2text.hpp"
+#include "fb2trace.h"
+
+#include <QWebFrame>
 
 //---------------------------------------------------------------------------
 //  FbTextElement::Scheme
@@ -10,7 +13,7 @@ FbTextElement::Scheme::Scheme()
 {
     m_types["BODY"]
         << Type("FB:DESCRIPTION", 1, 1)
-        << Type("FB:BODY", 1, 1)
+        << Type("FB:BODY", 1, 0)
     ;
 
     m_types["FB:DESCRIPTION"]
@@ -22,34 +25,34 @@ FbTextElement::Scheme::Scheme()
     ;
 
     m_types["FB:DOCUMENT-INFO"]
-        << Type("FB:AUTHOR", 1, 1)
+        << Type("FB:AUTHOR", 1, 0)
         << Type("FB:PROGRAM-USED", 0, 1)
         << Type("FB:DATE", 0, 1)
     ;
 
     m_types["FB:BODY"]
-        << Type("IMG")
+        << Type("IMG", 0, 1)
         << Type("FB:TITLE", 0, 1)
         << Type("FB:EPIGRAPH")
         << Type("FB:SECTION", 1, 0)
     ;
 
     m_types["FB:SECTION"]
-        << Type("FB:TITLE", 1, 0)
+        << Type("FB:TITLE", 0, 1)
         << Type("FB:EPIGRAPH")
-        << Type("IMG")
-        << Type("FB:ANNOTATION")
+        << Type("IMG", 0, 1)
+        << Type("FB:ANNOTATION", 0, 1)
         << Type("FB:SECTION")
     ;
 
     m_types["FB:POEM"]
-        << Type("FB:TITLE", 1, 0)
+        << Type("FB:TITLE", 0, 1)
         << Type("FB:EPIGRAPH", 0, 0)
         << Type("FB:STANZA", 1, 0)
     ;
 
     m_types["FB:STANZA"]
-        << Type("FB:TITLE", 1, 0)
+        << Type("FB:TITLE", 0, 1)
     ;
 }
 
@@ -60,6 +63,30 @@ const FbTextElement::TypeList * FbTextElement::Scheme::operator[](const QString
     return 0;
 }
 
+// Flattens the rules into tag names, per-container ranges and (tag, min, max) triples
+QString FbTextElement::Scheme::script() const
+{
+    QStringList tags;
+    QStringList ranges;
+    QStringList rules;
+    int offset = 0;
+    for (TypeMap::const_iterator it = m_types.begin(); it != m_types.end(); it++) {
+        const TypeList &list = it.value();
+        ranges << QString("%1:[%2,%3]").arg(jsString(it.key())).arg(offset).arg(list.count());
+        for (TypeList::const_iterator type = list.begin(); type != list.end(); type++) {
+            int tag = tags.indexOf(type->name());
+            if (tag < 0) {
+                tag = tags.count();
+                tags << type->name();
+            }
+            rules << QString("%1,%2,%3").arg(tag).arg(type->min()).arg(type->max());
+        }
+        offset += list.count();
+    }
+    for (int i = 0; i < tags.count(); i++) tags[i] = jsString(tags[i]);
+    return QString("fbSchemeInit([%1],{%2},[%3])").arg(tags.join(",")).arg(ranges.join(",")).arg(rules.join(","));
+}
+
 //---------------------------------------------------------------------------
 //  FbTextElement::Sublist
 //---------------------------------------------------------------------------
@@ -152,10 +179,20 @@ bool FbTextElement::hasScheme() const
     return subtypes();
 }
 
+const FbTextElement::Scheme & FbTextElement::scheme()
+{
+    static const Scheme scheme;
+    return scheme;
+}
+
+QString FbTextElement::schemeScript()
+{
+    return scheme().script();
+}
+
 const FbTextElement::TypeList * FbTextElement::subtypes() const
 {
-    static Scheme scheme;
-    return scheme[tagName()];
+    return scheme()[tagName()];
 }
 
 bool FbTextElement::hasSubtype(const QString &style) const
@@ -201,15 +238,15 @@ FbTextElement FbTextElement::insertInside(const QString &style, const QString &h
     return lastChild();
 }
 
-QString FbTextElement::location()
+int FbTextElement::nodeId()
 {
-    return evaluateJavaScript("location(this)").toString();
+    return evaluateJavaScript("fbId(this)").toInt();
 }
 
 void FbTextElement::select()
 {
-    QString javascript = jScript("set_cursor.js");
-    evaluateJavaScript(javascript);
+    FB2_TRACE("js:set_cursor");
+    evaluateJavaScript("fbSetCursor(this)");
 }
 
 bool FbTextElement::hasChild(const QString &style) const
@@ -273,7 +310,7 @@ FbTextElement FbTextElement::child(int index) const
 //---------------------------------------------------------------------------
 
 FbInsertCmd::FbInsertCmd(const FbTextElement &element)
-    : QUndoCommand()
+    : FbUndoCommand(sizeof(FbInsertCmd) + element.toOuterXml().size() * 2)
     , m_element(element)
     , m_parent(element.previousSibling())
     , m_inner(false)
@@ -300,33 +337,117 @@ void FbInsertCmd::undo()
 }
 
 //---------------------------------------------------------------------------
-//  FbReplaceCmd
+//  FbWrapCmd
 //---------------------------------------------------------------------------
 
-FbReplaceCmd::FbReplaceCmd(const FbTextElement &original, const FbTextElement &duplicate)
-    : QUndoCommand()
-    , m_original(original)
-    , m_duplicate(duplicate)
+FbWrapCmd::FbWrapCmd(const FbTextElement &element, int count)
+    : FbUndoCommand(sizeof(FbWrapCmd))
+    , m_element(element)
+    , m_parent(element.previousSibling())
+    , m_inner(false)
+    , m_count(count)
+{
+    if (m_parent.isNull()) {
+        m_parent = m_element.parent();
+        m_inner = true;
+    }
+}
+
+void FbWrapCmd::redo()
+{
+    if (m_inner) {
+        m_parent.prependInside(m_element);
+    } else {
+        m_parent.appendOutside(m_element);
+    }
+    m_element.evaluateJavaScript(QString("fbAbsorb(this,%1)").arg(m_count));
+    m_element.select();
+}
+
+void FbWrapCmd::undo()
+{
+    FbTextElement first = m_element.firstChild();
+    m_element.evaluateJavaScript("fbRelease(this)");
+    if (!first.isNull()) first.select();
+}
+
+//---------------------------------------------------------------------------
+//  FbUnwrapCmd
+//---------------------------------------------------------------------------
+
+FbUnwrapCmd::FbUnwrapCmd(const FbTextElement &element)
+    : FbUndoCommand(sizeof(FbUnwrapCmd))
+    , m_element(element)
+    , m_parent(element.previousSibling())
+    , m_inner(false)
+    , m_count(0)
+{
+    if (m_parent.isNull()) {
+        m_parent = m_element.parent();
+        m_inner = true;
+    }
+    if (element.index()) {
+        FbTextElement title = element.firstChild();
+        if (title.isTitle()) m_title = title;
+    }
+}
+
+void FbUnwrapCmd::redo()
+{
+    if (!m_title.isNull()) {
+        m_title.removeClass("title");
+        m_title.addClass("subtitle");
+    }
+    FbTextElement first = m_element.firstChild();
+    m_count = m_element.evaluateJavaScript("fbRelease(this)").toInt();
+    if (!first.isNull()) first.select();
+}
+
+void FbUnwrapCmd::undo()
+{
+    if (m_inner) {
+        m_parent.prependInside(m_element);
+    } else {
+        m_parent.appendOutside(m_element);
+    }
+    m_element.evaluateJavaScript(QString("fbAbsorb(this,%1)").arg(m_count));
+    if (!m_title.isNull()) {
+        m_title.removeClass("subtitle");
+        m_title.addClass("title");
+    }
+    m_element.select();
+}
+
+//---------------------------------------------------------------------------
+//  FbReplaceTextCmd
+//---------------------------------------------------------------------------
+
+FbReplaceTextCmd::FbReplaceTextCmd(QWebFrame *frame, int edit, int bytes)
+    : FbUndoCommand(sizeof(FbReplaceTextCmd) + bytes)
+    , m_frame(frame)
+    , m_edit(edit)
     , m_update(false)
 {
 }
 
-void FbReplaceCmd::redo()
+// The texts live in the page, release them together with the undo step
+FbReplaceTextCmd::~FbReplaceTextCmd()
+{
+    m_frame->evaluateJavaScript(QString("fbReplaceDrop(%1)").arg(m_edit));
+}
+
+void FbReplaceTextCmd::redo()
 {
     if (m_update) {
-        m_original.prependOutside(m_duplicate);
-        m_original.takeFromDocument();
-        m_duplicate.select();
+        m_frame->evaluateJavaScript(QString("fbReplaceApply(%1,true)").arg(m_edit));
     } else {
         m_update = true;
     }
 }
 
-void FbReplaceCmd::undo()
+void FbReplaceTextCmd::undo()
 {
-    m_duplicate.prependOutside(m_original);
-    m_duplicate.takeFromDocument();
-    m_original.select();
+    m_frame->evaluateJavaScript(QString("fbReplaceApply(%1,false)").arg(m_edit));
 }
 
 //---------------------------------------------------------------------------
@@ -334,7 +455,7 @@ void FbReplaceCmd::undo()
 //---------------------------------------------------------------------------
 
 FbDeleteCmd::FbDeleteCmd(const FbTextElement &element)
-    : QUndoCommand()
+    : FbUndoCommand(sizeof(FbDeleteCmd) + element.toOuterXml().size() * 2)
     , m_element(element)
     , m_parent(element.previousSibling())
     , m_inner(false)
@@ -365,7 +486,7 @@ void FbDeleteCmd::undo()
 //---------------------------------------------------------------------------
 
 FbMoveUpCmd::FbMoveUpCmd(const FbTextElement &element)
-    : QUndoCommand()
+    : FbUndoCommand(sizeof(FbMoveUpCmd))
     , m_element(element)
 {
 }
@@ -388,7 +509,7 @@ void FbMoveUpCmd::undo()
 //---------------------------------------------------------------------------
 
 FbMoveLeftCmd::FbMoveLeftCmd(const FbTextElement &element)
-    : QUndoCommand()
+    : FbUndoCommand(sizeof(FbMoveLeftCmd))
     , m_element(element)
     , m_subling(element.previousSibling())
     , m_parent(element.parent())
@@ -414,7 +535,7 @@ void FbMoveLeftCmd::undo()
 //---------------------------------------------------------------------------
 
 FbMoveRightCmd::FbMoveRightCmd(const FbTextElement &element)
-    : QUndoCommand()
+    : FbUndoCommand(sizeof(FbMoveRightCmd))
     , m_element(element)
     , m_subling(element.previousSibling())
 {
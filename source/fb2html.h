@@ -4,6 +4,10 @@
 #include <QUndoCommand>
 #include <QWebElement>
 
+QT_BEGIN_NAMESPACE
+class QWebFrame;
+QT_END_NAMESPACE
+
 class FbTextPage;
 
 class FbTextElement;
@@ -37,6 +41,7 @@ private:
     public:
         explicit Scheme();
         const TypeList * operator[](const QString &name) const;
+        QString script() const;
     private:
         TypeMap m_types;
     };
@@ -63,7 +68,8 @@ public:
     void getChildren(FbElementList &list);
     bool hasSubtype(const QString &style) const;
     bool hasScheme() const;
-    QString location();
+    static QString schemeScript();
+    int nodeId();
     int childIndex() const;
     int index() const;
 
@@ -89,11 +95,21 @@ public:
     void select();
 
 private:
+    static const Scheme & scheme();
     const TypeList *subtypes() const;
     TypeList::const_iterator subtype(const TypeList &list, const QString &style);
 };
 
-class FbInsertCmd : public QUndoCommand
+class FbUndoCommand : public QUndoCommand
+{
+public:
+    explicit FbUndoCommand(int bytes) : QUndoCommand(), m_bytes(bytes) {}
+    int bytes() const { return m_bytes; }
+protected:
+    int m_bytes;
+};
+
+class FbInsertCmd : public FbUndoCommand
 {
 public:
     explicit FbInsertCmd(const FbTextElement &element);
@@ -105,19 +121,34 @@ private:
     bool m_inner;
 };
 
-class FbReplaceCmd : public QUndoCommand
+class FbWrapCmd : public FbUndoCommand
 {
 public:
-    explicit FbReplaceCmd(const FbTextElement &original, const FbTextElement &duplicate);
+    explicit FbWrapCmd(const FbTextElement &element, int count);
     virtual void undo();
     virtual void redo();
 private:
-    FbTextElement m_original;
-    FbTextElement m_duplicate;
-    bool m_update;
+    FbTextElement m_element;
+    FbTextElement m_parent;
+    bool m_inner;
+    int m_count;
 };
 
-class FbDeleteCmd : public QUndoCommand
+class FbUnwrapCmd : public FbUndoCommand
+{
+public:
+    explicit FbUnwrapCmd(const FbTextElement &element);
+    virtual void undo();
+    virtual void redo();
+private:
+    FbTextElement m_element;
+    FbTextElement m_parent;
+    FbTextElement m_title;
+    bool m_inner;
+    int m_count;
+};
+
+class FbDeleteCmd : public FbUndoCommand
 {
 public:
     explicit FbDeleteCmd(const FbTextElement &element);
@@ -129,7 +160,20 @@ private:
     bool m_inner;
 };
 
-class FbMoveUpCmd : public QUndoCommand
+class FbReplaceTextCmd : public FbUndoCommand
+{
+public:
+    explicit FbReplaceTextCmd(QWebFrame *frame, int edit, int bytes);
+    virtual ~FbReplaceTextCmd();
+    virtual void undo();
+    virtual void redo();
+private:
+    QWebFrame *m_frame;
+    int m_edit;
+    bool m_update;
+};
+
+class FbMoveUpCmd : public FbUndoCommand
 {
 public:
     explicit FbMoveUpCmd(const FbTextElement &element);
@@ -139,7 +183,7 @@ private:
     FbTextElement m_element;
 };
 
-class FbMoveLeftCmd : public QUndoCommand
+class FbMoveLeftCmd : public FbUndoCommand
 {
 public:
     explicit FbMoveLeftCmd(const FbTextElement &element);
@@ -151,7 +195,7 @@ private:
     FbTextElement m_parent;
 };
 
-class FbMoveRightCmd : public QUndoCommand
+class FbMoveRightCmd : public FbUndoCommand
 {
 public:
     explicit FbMoveRightCmd(const FbTextElement &element);
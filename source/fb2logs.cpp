@@ -33,7 +33,11 @@ QVariant FbLogModel::data(const QModelIndex &index, int role) const
     if (row < 0) return QVariant();
     if (row >= m_list.count()) return QVariant();
     switch (role) {
-        case Qt::DisplayRole: return m_list.at(row)->msg();
+        case Qt::DisplayRole: {
+            FbLogItem *item = m_list.at(row);
+            if (item->row() <= 0) return item->msg();
+            return QString("%1:%2: %3").arg(item->row()).arg(item->col()).arg(item->msg());
+        }
         case Qt::DecorationRole: return m_list.at(row)->icon();
     }
     return QVariant();
@@ -60,6 +64,15 @@ void FbLogModel::add(QtMsgType type, const QString &msg)
     add(type, 0, 0, msg);
 }
 
+void FbLogModel::location(const QModelIndex &index, int &row, int &col) const
+{
+    row = col = 0;
+    int i = index.row();
+    if (i < 0 || i >= m_list.count()) return;
+    row = m_list.at(i)->row();
+    col = m_list.at(i)->col();
+}
+
 //---------------------------------------------------------------------------
 //  FbLogList
 //---------------------------------------------------------------------------
@@ -82,6 +95,7 @@ FbLogDock::FbLogDock(const QString &title, QWidget *parent, Qt::WindowFlags flag
 {
     m_list->setModel(m_model);
     connect(m_model, SIGNAL(changeCurrent(QModelIndex)), m_list, SLOT(setCurrentIndex(QModelIndex)));
+    connect(m_list, SIGNAL(activated(QModelIndex)), SLOT(activated(QModelIndex)));
     setFeatures(QDockWidget::AllDockWidgetFeatures);
     setAttribute(Qt::WA_DeleteOnClose);
     setWidget(m_list);
@@ -92,3 +106,15 @@ void FbLogDock::append(QtMsgType type, const QString &message)
     m_model->add(type, message);
 }
 
+void FbLogDock::append(QtMsgType type, int row, int col, const QString &message)
+{
+    m_model->add(type, row, col, message);
+}
+
+void FbLogDock::activated(const QModelIndex &index)
+{
+    int row, col;
+    m_model->location(index, row, col);
+    if (row > 0) emit locate(row, col);
+}
+
@@ -18,6 +18,8 @@ public:
     virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
 
+    void location(const QModelIndex &index, int &row, int &col) const;
+
 signals:
     void changeCurrent(const QModelIndex &index);
 
@@ -34,7 +36,7 @@ private:
         const QString & msg() const { return m_msg; }
         QtMsgType type() const { return m_type; }
         int row() const { return m_row; }
-        int col() const { return m_row; }
+        int col() const { return m_col; }
         QVariant icon() const;
 
     private:
@@ -70,6 +72,13 @@ class FbLogDock: public QDockWidget
 public:
     explicit FbLogDock(const QString &title, QWidget *parent = 0, Qt::WindowFlags flags = 0);
     void append(QtMsgType type, const QString &message);
+    void append(QtMsgType type, int row, int col, const QString &message);
+
+signals:
+    void locate(int row, int col);
+
+private slots:
+    void activated(const QModelIndex &index);
 
 private:
     FbLogModel *m_model;
@@ -6,13 +6,17 @@
 #include <QWebFrame>
 
 #include "fb2app.hpp"
+#include "fb2batch.h"
 #include "fb2logs.hpp"
 #include "fb2code.hpp"
 #include "fb2dlgs.hpp"
 #include "fb2dock.hpp"
 #include "fb2logs.hpp"
+#include "fb2memo.hpp"
+#include "fb2norm.hpp"
 #include "fb2save.hpp"
 #include "fb2text.hpp"
+#include "fb2trace.h"
 #include "fb2utils.h"
 
 //---------------------------------------------------------------------------
@@ -24,6 +28,7 @@ FbMainWindow::FbMainWindow(const QString &filename, ViewMode mode)
     , noteEdit(0)
     , toolEdit(0)
     , logDock(0)
+    , memoryDock(0)
     , isSwitched(false)
     , isUntitled(true)
 {
@@ -51,33 +56,33 @@ FbMainWindow::FbMainWindow(const QString &filename, ViewMode mode)
 
 void FbMainWindow::warning(int row, int col, const QString &msg)
 {
-    Q_UNUSED(row);
-    Q_UNUSED(col);
-    logMessage(QtWarningMsg, msg.simplified());
+    logMessage(QtWarningMsg, row, col, msg.simplified());
 }
 
 void FbMainWindow::error(int row, int col, const QString &msg)
 {
-    Q_UNUSED(row);
-    Q_UNUSED(col);
-    logMessage(QtCriticalMsg, msg.simplified());
+    logMessage(QtCriticalMsg, row, col, msg.simplified());
 }
 
 void FbMainWindow::fatal(int row, int col, const QString &msg)
 {
-    Q_UNUSED(row);
-    Q_UNUSED(col);
-    logMessage(QtFatalMsg, msg.simplified());
+    logMessage(QtFatalMsg, row, col, msg.simplified());
 }
 
 void FbMainWindow::logMessage(QtMsgType type, const QString &message)
+{
+    logMessage(type, 0, 0, message);
+}
+
+void FbMainWindow::logMessage(QtMsgType type, int row, int col, const QString &message)
 {
     if (!logDock) {
         logDock = new FbLogDock(tr("Message log"), this);
         connect(logDock, SIGNAL(destroyed()), SLOT(logDestroyed()));
+        connect(logDock, SIGNAL(locate(int,int)), mainDock, SLOT(error(int,int)));
         addDockWidget(Qt::BottomDockWidgetArea, logDock);
     }
-    logDock->append(type, message);
+    logDock->append(type, row, col, message);
 }
 
 void FbMainWindow::logDestroyed()
@@ -85,6 +90,22 @@ void FbMainWindow::logDestroyed()
     logDock = NULL;
 }
 
+void FbMainWindow::viewMemory()
+{
+    if (!memoryDock) {
+        memoryDock = new FbDockWidget(tr("Memory usage"), this);
+        memoryDock->setWidget(new FbMemoryView(mainDock, memoryDock));
+        connect(memoryDock, SIGNAL(destroyed()), SLOT(memoryDestroyed()));
+        addDockWidget(Qt::RightDockWidgetArea, memoryDock);
+    }
+    memoryDock->show();
+}
+
+void FbMainWindow::memoryDestroyed()
+{
+    memoryDock = NULL;
+}
+
 void FbMainWindow::closeEvent(QCloseEvent *event)
 {
     if (maybeSave()) {
@@ -145,6 +166,33 @@ bool FbMainWindow::fileSaveAs()
     return saveFile(fileName, dlg.codec());
 }
 
+void FbMainWindow::fileNormalize()
+{
+    QString filename = QFileDialog::getOpenFileName(this, tr("Normalize file"), QString(), "Fiction book files (*.fb2)");
+    if (filename.isEmpty()) return;
+
+    // The save dialog asks before the source itself is overwritten
+    QString target = QFileDialog::getSaveFileName(this, tr("Save normalized file"), filename, "Fiction book files (*.fb2)");
+    if (target.isEmpty()) return;
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QTime time;
+    time.start();
+    QString message;
+    qint64 bytes = QFileInfo(filename).size();
+    bool ok = FbNormHandler::normalize(filename, target, message);
+    int msecs = time.elapsed();
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::warning(this, qApp->applicationName(), tr("Cannot normalize file %1: %2.").arg(filename).arg(message));
+        return;
+    }
+
+    QString speed = QString::number(FbBatch::mbps(bytes, msecs), 'f', 2);
+    statusBar()->showMessage(tr("File normalized in %1 ms (%2 MB/s)").arg(msecs).arg(speed), 5000);
+}
+
 void FbMainWindow::about()
 {
     QString text = tr("<b>fb2edit</b> is an application for creating and editing FB2-files.");
@@ -206,6 +254,11 @@ void FbMainWindow::createActions()
     connect(act, SIGNAL(triggered()), this, SLOT(fileSaveAs()));
     menu->addAction(act);
 
+    act = new QAction(tr("&Normalize file..."), this);
+    act->setStatusTip(tr("Rewrite a file on disk in the canonical FB2 layout"));
+    connect(act, SIGNAL(triggered()), this, SLOT(fileNormalize()));
+    menu->addAction(act);
+
 #ifdef QT_DEBUG
     act = new QAction(tr("&Export HTML"), this);
     connect(act, SIGNAL(triggered()), text, SLOT(exportHtml()));
@@ -503,6 +556,31 @@ void FbMainWindow::createActions()
     act->setCheckable(true);
     menu->addAction(act);
 
+    menu->addSeparator();
+
+    act = new QAction(tr("Record &trace"), this);
+    act->setCheckable(true);
+    act->setChecked(FbTrace::enabled());
+    act->setStatusTip(tr("Record timings of loading, saving and editing"));
+    connect(act, SIGNAL(triggered(bool)), this, SLOT(traceRecord(bool)));
+    menu->addAction(act);
+
+    act = new QAction(tr("Save trace..."), this);
+    act->setStatusTip(tr("Save recorded timings in Chrome trace format"));
+    connect(act, SIGNAL(triggered()), this, SLOT(traceSave()));
+    menu->addAction(act);
+
+    act = new QAction(tr("&Memory usage"), this);
+    act->setStatusTip(tr("Show the memory held by this document"));
+    connect(act, SIGNAL(triggered()), this, SLOT(viewMemory()));
+    menu->addAction(act);
+
+#ifdef QT_DEBUG
+    act = new QAction(tr("&Undo memory"), this);
+    connect(act, SIGNAL(triggered()), text, SLOT(viewUndo()));
+    menu->addAction(act);
+#endif // QT_DEBUG
+
     menuBar()->addSeparator();
     menu = menuBar()->addMenu(tr("&Help"));
 
@@ -529,6 +607,23 @@ void FbMainWindow::openSettings()
     dlg.exec();
 }
 
+void FbMainWindow::traceRecord(bool enabled)
+{
+    if (enabled) FbTrace::clear();
+    FbTrace::setEnabled(enabled);
+}
+
+void FbMainWindow::traceSave()
+{
+    QString filename = QFileDialog::getSaveFileName(this, tr("Save trace"), "fb2trace.json", "Trace files (*.json)");
+    if (filename.isEmpty()) return;
+    if (!FbTrace::save(filename)) {
+        QMessageBox::warning(this, qApp->applicationName(), tr("Cannot write file %1.").arg(filename));
+        return;
+    }
+    statusBar()->showMessage(tr("%1 trace events saved").arg(FbTrace::count()), 5000);
+}
+
 void FbMainWindow::createStatusBar()
 {
     statusBar()->showMessage(tr("Ready"));
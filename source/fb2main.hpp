@@ -48,12 +48,17 @@ private slots:
     void fileOpen();
     bool fileSave();
     bool fileSaveAs();
+    void fileNormalize();
 
     void about();
     void textChanged(bool modified);
     void logDestroyed();
+    void viewMemory();
+    void memoryDestroyed();
 
     void openSettings();
+    void traceRecord(bool enabled);
+    void traceSave();
 
 private:
     QString appTitle() const;
@@ -64,6 +69,7 @@ private:
     void createImgs();
     void createActions();
     void createStatusBar();
+    void logMessage(QtMsgType type, int row, int col, const QString &message);
     void readSettings();
     void writeSettings();
     bool maybeSave();
@@ -75,6 +81,7 @@ private:
     QTextEdit *noteEdit;
     QToolBar *toolEdit;
     FbLogDock *logDock;
+    QDockWidget *memoryDock;
     QString curFile;
     bool isSwitched;
     bool isUntitled;
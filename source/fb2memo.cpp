@@ -0,0 +1,163 @@
+#include "fb2memo.hpp"
+
+#include <QLocale>
+#include <QSet>
+#include <QTextDocument>
+#include <QUndoStack>
+
+#include "fb2code.hpp"
+#include "fb2dock.hpp"
+#include "fb2imgs.hpp"
+#include "fb2page.hpp"
+#include "fb2text.hpp"
+
+//---------------------------------------------------------------------------
+//  FbMemoryView
+//---------------------------------------------------------------------------
+
+namespace {
+
+// QtWebKit has no way to measure a page, these are rough costs per node
+const qint64 s_elementBytes = 256;  // element with its render object and style
+const qint64 s_hiddenBytes = 128;   // detached element of an evicted section
+const qint64 s_blockBytes = 160;    // QTextBlock with its layout in the XML editor
+
+}
+
+FbMemoryView::FbMemoryView(FbMainDock *dock, QWidget *parent)
+    : QTreeWidget(parent)
+    , m_dock(dock)
+{
+    setColumnCount(2);
+    setHeaderLabels(QStringList() << tr("Item") << tr("Bytes"));
+    connect(&m_timer, SIGNAL(timeout()), SLOT(updateList()));
+    m_timer.setInterval(5000);
+}
+
+void FbMemoryView::showEvent(QShowEvent *event)
+{
+    QTreeWidget::showEvent(event);
+    updateList();
+    m_timer.start();
+}
+
+void FbMemoryView::hideEvent(QHideEvent *event)
+{
+    m_timer.stop();
+    QTreeWidget::hideEvent(event);
+}
+
+QTreeWidgetItem * FbMemoryView::addItem(QTreeWidgetItem *parent, const QString &text, qint64 bytes)
+{
+    QTreeWidgetItem *item = parent ? new QTreeWidgetItem(parent) : new QTreeWidgetItem(this);
+    item->setText(0, text);
+    item->setText(1, QLocale().toString(bytes));
+    item->setTextAlignment(1, Qt::AlignRight);
+    return item;
+}
+
+QTreeWidgetItem * FbMemoryView::addText(qint64 &total)
+{
+    FbTextPage *page = m_dock->text()->page();
+    QTreeWidgetItem *parent = addItem(0, tr("Text editor"), 0);
+    qint64 sum = 0, bytes;
+
+    bytes = page->pendingBytes();
+    addItem(parent, tr("HTML in conversion"), bytes);
+    sum += bytes;
+
+    bytes = page->htmlBytes();
+    addItem(parent, tr("HTML source"), bytes);
+    sum += bytes;
+
+    QVariantMap memory = page->memory();
+    int elements = memory.value("elements").toInt();
+    bytes = elements * s_elementBytes + memory.value("chars").toLongLong() * 2;
+    addItem(parent, tr("Document, %1 elements").arg(elements), bytes);
+    sum += bytes;
+
+    int hidden = memory.value("hidden").toInt();
+    bytes = hidden * s_hiddenBytes + memory.value("hiddenChars").toLongLong() * 2;
+    addItem(parent, tr("Evicted sections, %1 elements").arg(hidden), bytes);
+    sum += bytes;
+
+    m_images = memory.value("images").toStringList();
+    bytes = memory.value("pixels").toLongLong() * 4;
+    addItem(parent, tr("Decoded pictures, %1").arg(m_images.count()), bytes);
+    sum += bytes;
+
+    QUndoStack *stack = page->undoStack();
+    QTreeWidgetItem *undo = addItem(parent, QString(), 0);
+    qint64 undoBytes = 0;
+    int count = stack->count();
+    for (int i = 0; i < count; ++i) {
+        const QUndoCommand *command = stack->command(i);
+        bytes = FbTextPage::undoBytes(command);
+        undoBytes += bytes;
+        QTreeWidgetItem *item = addItem(undo, command->text(), bytes);
+        if (i >= stack->index()) item->setForeground(0, Qt::gray);
+    }
+    undo->setText(0, tr("Undo history, %1 commands").arg(count));
+    undo->setText(1, QLocale().toString(undoBytes));
+    sum += undoBytes;
+
+    parent->setText(1, QLocale().toString(sum));
+    total += sum;
+    return parent;
+}
+
+QTreeWidgetItem * FbMemoryView::addImages(qint64 &total)
+{
+    FbStore *store = m_dock->text()->store();
+    QTreeWidgetItem *parent = addItem(0, tr("Pictures"), 0);
+    if (!store) return parent;
+
+    // WebKit keeps the encoded copy of every picture it has shown
+    QSet<QString> shown = m_images.toSet();
+    qint64 disk = 0, cache = 0;
+    int count = store->count();
+    for (int i = 0; i < count; ++i) {
+        FbBinary *binary = store->at(i);
+        disk += binary->size();
+        if (shown.contains(binary->name())) cache += binary->size();
+    }
+    addItem(parent, tr("On disk, %1 files").arg(count), disk);
+    addItem(parent, tr("In memory, %1 cached").arg(shown.count()), cache);
+
+    parent->setText(1, QLocale().toString(cache));
+    total += cache;
+    return parent;
+}
+
+QTreeWidgetItem * FbMemoryView::addCode(qint64 &total)
+{
+    QTextDocument *document = m_dock->code()->document();
+    qint64 bytes = qint64(document->characterCount()) * 2 + document->blockCount() * s_blockBytes;
+    QTreeWidgetItem *parent = addItem(0, tr("XML editor"), bytes);
+    addItem(parent, tr("Document, %1 lines").arg(document->blockCount()), bytes);
+    total += bytes;
+    return parent;
+}
+
+void FbMemoryView::updateList()
+{
+    QSet<QString> expanded;
+    for (int i = 0; i < topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = topLevelItem(i);
+        if (item->isExpanded()) expanded << item->text(0);
+    }
+    bool initial = !topLevelItemCount();
+
+    clear();
+    qint64 total = 0;
+    addText(total);
+    addImages(total);
+    addCode(total);
+    addItem(0, tr("Total"), total);
+
+    for (int i = 0; i < topLevelItemCount(); ++i) {
+        QTreeWidgetItem *item = topLevelItem(i);
+        item->setExpanded(initial || expanded.contains(item->text(0)));
+    }
+    resizeColumnToContents(0);
+}
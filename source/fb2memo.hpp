@@ -0,0 +1,35 @@
+#ifndef FB2MEMO_H
+#define FB2MEMO_H
+
+#include <QTimer>
+#include <QTreeWidget>
+
+class FbMainDock;
+
+class FbMemoryView : public QTreeWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FbMemoryView(FbMainDock *dock, QWidget *parent = 0);
+
+protected:
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+
+private slots:
+    void updateList();
+
+private:
+    QTreeWidgetItem * addItem(QTreeWidgetItem *parent, const QString &text, qint64 bytes);
+    QTreeWidgetItem * addText(qint64 &total);
+    QTreeWidgetItem * addImages(qint64 &total);
+    QTreeWidgetItem * addCode(qint64 &total);
+
+private:
+    FbMainDock *m_dock;
+    QTimer m_timer;
+    QStringList m_images;
+};
+
+#endif // FB2MEMO_H
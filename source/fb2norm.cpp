@@ -0,0 +1,417 @@
+#include "fb2norm.hpp"
+#include "fb2xml2.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QTemporaryFile>
+
+#include <stdio.h>
+
+// Base64 characters held back before a binary is opened, enough to sniff the image format
+#define FB2_SNIFF_SIZE 1024
+
+//---------------------------------------------------------------------------
+//  FbNormHandler::TextHandler
+//---------------------------------------------------------------------------
+
+FB2_BEGIN_KEYHASH(FbNormHandler::TextHandler)
+    FB2_KEY( Anchor  , "a"           );
+    FB2_KEY( Image   , "image"       );
+    FB2_KEY( Parag   , "empty-line"  );
+    FB2_KEY( Parag   , "text-author" );
+    FB2_KEY( Parag   , "subtitle"    );
+    FB2_KEY( Parag   , "p"           );
+    FB2_KEY( Parag   , "v"           );
+FB2_END_KEYHASH
+
+FbNormHandler::TextHandler::TextHandler(FbNormHandler &owner, const QString &name, const QXmlAttributes &atts, const QString &tag)
+    : NodeHandler(name)
+    , m_owner(owner)
+    , m_tag(tag)
+    , m_level(1)
+    , m_hasChild(false)
+{
+    if (tag.isEmpty()) return;
+    m_owner.writeStartElement(m_tag, m_level);
+    writeAtts(atts);
+}
+
+FbNormHandler::TextHandler::TextHandler(TextHandler *parent, const QString &name, const QXmlAttributes &atts, const QString &tag)
+    : NodeHandler(name)
+    , m_owner(parent->m_owner)
+    , m_tag(tag)
+    , m_level(parent->nextLevel())
+    , m_hasChild(false)
+{
+    if (tag.isEmpty()) return;
+    m_owner.writeStartElement(m_tag, m_level);
+    writeAtts(atts);
+}
+
+void FbNormHandler::TextHandler::writeAtts(const QXmlAttributes &atts)
+{
+    Keyword key = toKeyword(m_tag);
+    int count = atts.count();
+    for (int i = 0; i < count; i++) {
+        QString name = atts.qName(i);
+        QString value = atts.value(i);
+        if (key == Anchor || key == Image) {
+            if (atts.localName(i) == "href") name = "l:href";
+        }
+        if (key == Image && name == "l:href" && value.left(1) == "#") {
+            m_owner.m_names.insert(value.mid(1));
+        }
+        m_owner.m_writer.writeAttribute(name, value);
+    }
+}
+
+FbXmlHandler::NodeHandler * FbNormHandler::TextHandler::NewTag(const QString &name, const QXmlAttributes &atts)
+{
+    m_hasChild = true;
+    if (toKeyword(name) == Parag) return new ParagHandler(this, name, atts);
+    return new TextHandler(this, name, atts, name);
+}
+
+void FbNormHandler::TextHandler::TxtTag(const QString &text)
+{
+    m_owner.m_writer.writeCharacters(text);
+}
+
+void FbNormHandler::TextHandler::EndTag(const QString &name)
+{
+    Q_UNUSED(name);
+    if (m_tag.isEmpty()) return;
+    m_owner.writeEndElement(m_hasChild ? m_level : 0);
+}
+
+int FbNormHandler::TextHandler::nextLevel() const
+{
+    return m_level ? m_level + 1 : 0;
+}
+
+//---------------------------------------------------------------------------
+//  FbNormHandler::RootHandler
+//---------------------------------------------------------------------------
+
+FbNormHandler::RootHandler::RootHandler(FbNormHandler &owner, const QString &name)
+    : TextHandler(owner, name, QXmlAttributes(), "FictionBook")
+{
+    m_owner.m_writer.writeAttribute("xmlns", "http://www.gribuser.ru/xml/fictionbook/2.0");
+    m_owner.m_writer.writeAttribute("xmlns:l", "http://www.w3.org/1999/xlink");
+}
+
+FbXmlHandler::NodeHandler * FbNormHandler::RootHandler::NewTag(const QString &name, const QXmlAttributes &atts)
+{
+    m_hasChild = true;
+    if (name == "stylesheet") return new StyleHandler(m_owner, name);
+    if (name == "binary") return new BinaryHandler(m_owner, name, atts);
+    return new TextHandler(this, name, atts, name);
+}
+
+void FbNormHandler::RootHandler::EndTag(const QString &name)
+{
+    foreach (Binary binary, m_owner.m_deferred) {
+        if (!m_owner.m_names.contains(binary.file)) continue;
+        m_owner.writeBinaryStart(binary.file, binary.type, binary.data);
+        m_owner.writeBinaryData(binary.data, true);
+        m_owner.writeBinaryEnd();
+    }
+    m_owner.m_deferred.clear();
+    TextHandler::EndTag(name);
+}
+
+//---------------------------------------------------------------------------
+//  FbNormHandler::ParagHandler
+//---------------------------------------------------------------------------
+
+FbNormHandler::ParagHandler::ParagHandler(TextHandler *parent, const QString &name, const QXmlAttributes &atts)
+    : TextHandler(parent, name, atts, "")
+    , m_parent(parent->tag())
+    , m_empty(true)
+{
+    if (name == "text-author" || name == "subtitle") m_class = name;
+    int count = atts.count();
+    for (int i = 0; i < count; i++) {
+        m_atts.append(atts.qName(i), "", "", atts.value(i));
+    }
+}
+
+FbXmlHandler::NodeHandler * FbNormHandler::ParagHandler::NewTag(const QString &name, const QXmlAttributes &atts)
+{
+    start();
+    return TextHandler::NewTag(name, atts);
+}
+
+void FbNormHandler::ParagHandler::TxtTag(const QString &text)
+{
+    if (m_empty) {
+        if (isWhiteSpace(text)) return;
+        start();
+    }
+    TextHandler::TxtTag(text);
+}
+
+void FbNormHandler::ParagHandler::EndTag(const QString &name)
+{
+    Q_UNUSED(name);
+    if (m_empty) m_owner.writeStartElement("empty-line", m_level);
+    m_owner.writeEndElement(0);
+}
+
+void FbNormHandler::ParagHandler::start()
+{
+    if (!m_empty) return;
+    QString tag = "p";
+    if (m_class.isEmpty()) {
+        if (m_parent == "stanza") tag = "v";
+    } else {
+        tag = m_class;
+    }
+    m_owner.writeStartElement(tag, m_level);
+    writeAtts(m_atts);
+    m_empty = false;
+}
+
+//---------------------------------------------------------------------------
+//  FbNormHandler::StyleHandler
+//---------------------------------------------------------------------------
+
+FbNormHandler::StyleHandler::StyleHandler(FbNormHandler &owner, const QString &name)
+    : NodeHandler(name)
+    , m_owner(owner)
+{
+}
+
+void FbNormHandler::StyleHandler::TxtTag(const QString &text)
+{
+    m_text += text;
+}
+
+void FbNormHandler::StyleHandler::EndTag(const QString &name)
+{
+    Q_UNUSED(name);
+    if (m_text.simplified().isEmpty()) return;
+
+    const QString postfix = "\n  ";
+    m_owner.writeStartElement("stylesheet", 2);
+    m_owner.m_writer.writeAttribute("type", "text/css");
+    m_owner.m_writer.writeCharacters(postfix);
+
+    QStringList list = m_text.split("}", QString::SkipEmptyParts);
+    foreach (const QString &str, list) {
+        QString line = str.simplified();
+        if (line.isEmpty()) continue;
+        m_owner.m_writer.writeCharacters("  " + line + "}" + postfix);
+    }
+    m_owner.m_writer.writeEndElement();
+}
+
+//---------------------------------------------------------------------------
+//  FbNormHandler::BinaryHandler
+//---------------------------------------------------------------------------
+
+FbNormHandler::BinaryHandler::BinaryHandler(FbNormHandler &owner, const QString &name, const QXmlAttributes &atts)
+    : NodeHandler(name)
+    , m_owner(owner)
+    , m_file(Value(atts, "id"))
+    , m_type(Value(atts, "content-type"))
+    , m_defer(!owner.m_names.contains(m_file))
+    , m_started(false)
+{
+}
+
+// A binary not referenced yet may still be used by a body further on,
+// it is held in memory and written at the end if a reference turns up
+void FbNormHandler::BinaryHandler::TxtTag(const QString &text)
+{
+    if (m_file.isEmpty()) return;
+    foreach (QChar ch, text) {
+        if (!ch.isSpace()) m_data += ch;
+    }
+    if (m_defer) return;
+    if (!m_started && m_data.length() >= FB2_SNIFF_SIZE) {
+        m_owner.writeBinaryStart(m_file, m_type, m_data);
+        m_started = true;
+    }
+    if (m_started) m_owner.writeBinaryData(m_data, false);
+}
+
+void FbNormHandler::BinaryHandler::EndTag(const QString &name)
+{
+    Q_UNUSED(name);
+    if (m_file.isEmpty()) return;
+    if (m_defer) {
+        Binary binary;
+        binary.file = m_file;
+        binary.type = m_type;
+        binary.data = m_data;
+        m_owner.m_deferred << binary;
+        return;
+    }
+    if (!m_started) m_owner.writeBinaryStart(m_file, m_type, m_data);
+    m_owner.writeBinaryData(m_data, true);
+    m_owner.writeBinaryEnd();
+}
+
+//---------------------------------------------------------------------------
+//  FbNormHandler
+//---------------------------------------------------------------------------
+
+void FbNormHandler::writeBinaryStart(const QString &file, const QString &type, const QString &data)
+{
+    writeStartElement("binary", 2);
+    m_writer.writeAttribute("id", file);
+
+    QByteArray head = QByteArray::fromBase64(data.left(qMin(data.length(), FB2_SNIFF_SIZE) & ~3).toLatin1());
+    QBuffer buffer(&head);
+    buffer.open(QIODevice::ReadOnly);
+    QString format = QImageReader::imageFormat(&buffer);
+    if (format.isEmpty()) {
+        format = type;
+    } else {
+        format.prepend("image/");
+    }
+    if (!format.isEmpty()) m_writer.writeAttribute("content-type", format);
+    writeLineEnd();
+}
+
+void FbNormHandler::writeBinaryData(QString &data, bool all)
+{
+    int pos = 0;
+    while (data.length() - pos >= 76 || (all && pos < data.length())) {
+        m_writer.writeCharacters(data.mid(pos, 76));
+        writeLineEnd();
+        pos += 76;
+    }
+    data.remove(0, qMin(pos, data.length()));
+}
+
+void FbNormHandler::writeBinaryEnd()
+{
+    m_writer.writeCharacters("  ");
+    m_writer.writeEndElement();
+}
+
+bool FbNormHandler::normalize(const QString &source, const QString &target, QString &message)
+{
+    QFile input(source);
+    if (!input.open(QIODevice::ReadOnly)) {
+        message = input.errorString();
+        return false;
+    }
+
+    // Write next to the target and rename over it, so a failed run never leaves a truncated book
+    QTemporaryFile output(QFileInfo(target).absolutePath() + "/.fb2norm.XXXXXX");
+    if (!output.open()) {
+        message = output.errorString();
+        return false;
+    }
+
+    if (!normalize(&input, &output, message)) return false;
+    if (!output.flush() || output.error() != QFile::NoError) {
+        message = output.errorString();
+        return false;
+    }
+    output.close();
+    input.close();
+
+    // QTemporaryFile creates the file with mode 0600; keep the book's own permissions
+    output.setPermissions(QFile::permissions(source));
+
+    QByteArray temp = QFile::encodeName(output.fileName());
+    QByteArray name = QFile::encodeName(target);
+    bool ok = ::rename(temp.constData(), name.constData()) == 0;
+#ifdef Q_OS_WIN
+    // rename() does not overwrite on Windows
+    if (!ok) ok = QFile::remove(target) && QFile::rename(output.fileName(), target);
+#endif
+    if (!ok) {
+        message = QObject::tr("Cannot replace %1").arg(target);
+        return false;
+    }
+    output.setAutoRemove(false);
+    return true;
+}
+
+bool FbNormHandler::normalize(QIODevice *input, QIODevice *output, QString &message)
+{
+    FbNormHandler handler(output);
+
+#ifdef FB2_USE_LIBXML2
+    XML2::XmlReader reader;
+#else
+    QXmlSimpleReader reader;
+#endif
+
+    reader.setContentHandler(&handler);
+    reader.setLexicalHandler(&handler);
+    reader.setErrorHandler(&handler);
+
+#ifdef FB2_USE_LIBXML2
+    bool ok = reader.parse(input);
+#else
+    QXmlInputSource source(input);
+    bool ok = reader.parse(source);
+#endif
+
+    message = handler.message();
+    if (message.isEmpty()) message = handler.errorString();
+    if (!ok) return false;
+
+    handler.m_writer.writeEndDocument();
+    if (handler.m_writer.hasError()) {
+        message = output->errorString();
+        return false;
+    }
+    return true;
+}
+
+FbNormHandler::FbNormHandler(QIODevice *device)
+    : FbXmlHandler()
+    , m_writer(device)
+{
+    m_writer.writeStartDocument();
+}
+
+FbXmlHandler::NodeHandler * FbNormHandler::CreateRoot(const QString &name, const QXmlAttributes &atts)
+{
+    Q_UNUSED(atts);
+    if (name == "fictionbook") return new RootHandler(*this, name);
+    m_error = QObject::tr("The file is not an FB2 file.");
+    return 0;
+}
+
+bool FbNormHandler::comment(const QString& ch)
+{
+    if (!m_handler) return true;
+    writeLineEnd();
+    m_writer.writeComment(ch);
+    return true;
+}
+
+bool FbNormHandler::fatalError(const QXmlParseException &exception)
+{
+    m_message = QString("%1:%2 %3").arg(exception.lineNumber()).arg(exception.columnNumber()).arg(exception.message());
+    return FbXmlHandler::fatalError(exception);
+}
+
+void FbNormHandler::writeStartElement(const QString &name, int level)
+{
+    if (level) writeLineEnd();
+    for (int i = 1; i < level; i++) m_writer.writeCharacters("  ");
+    m_writer.writeStartElement(name);
+}
+
+void FbNormHandler::writeEndElement(int level)
+{
+    if (level) writeLineEnd();
+    for (int i = 1; i < level; i++) m_writer.writeCharacters("  ");
+    m_writer.writeEndElement();
+}
+
+void FbNormHandler::writeLineEnd()
+{
+    m_writer.writeCharacters("\n");
+}
@@ -0,0 +1,131 @@
+#ifndef FB2NORM_H
+#define FB2NORM_H
+
+#include "fb2xml.hpp"
+
+#include <QSet>
+#include <QStringList>
+#include <QXmlStreamWriter>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
+class FbNormHandler : public FbXmlHandler
+{
+    Q_OBJECT
+
+public:
+    static bool normalize(const QString &source, const QString &target, QString &message);
+    static bool normalize(QIODevice *input, QIODevice *output, QString &message);
+    explicit FbNormHandler(QIODevice *device);
+    virtual bool comment(const QString& ch);
+    bool fatalError(const QXmlParseException &exception);
+    const QString & message() const { return m_message; }
+
+private:
+    class TextHandler : public NodeHandler
+    {
+        FB2_BEGIN_KEYLIST
+            Anchor,
+            Image,
+            Parag,
+        FB2_END_KEYLIST
+    public:
+        explicit TextHandler(FbNormHandler &owner, const QString &name, const QXmlAttributes &atts, const QString &tag);
+        explicit TextHandler(TextHandler *parent, const QString &name, const QXmlAttributes &atts, const QString &tag);
+        const QString & tag() const { return m_tag; }
+    protected:
+        virtual NodeHandler * NewTag(const QString &name, const QXmlAttributes &atts);
+        virtual void TxtTag(const QString &text);
+        virtual void EndTag(const QString &name);
+    protected:
+        void writeAtts(const QXmlAttributes &atts);
+        virtual int nextLevel() const;
+    protected:
+        FbNormHandler &m_owner;
+        const QString m_tag;
+        const int m_level;
+        bool m_hasChild;
+    };
+
+    class RootHandler : public TextHandler
+    {
+    public:
+        explicit RootHandler(FbNormHandler &owner, const QString &name);
+    protected:
+        virtual NodeHandler * NewTag(const QString &name, const QXmlAttributes &atts);
+        virtual void EndTag(const QString &name);
+    };
+
+    class ParagHandler : public TextHandler
+    {
+    public:
+        explicit ParagHandler(TextHandler *parent, const QString &name, const QXmlAttributes &atts);
+    protected:
+        virtual NodeHandler * NewTag(const QString &name, const QXmlAttributes &atts);
+        virtual void TxtTag(const QString &text);
+        virtual void EndTag(const QString &name);
+    private:
+        virtual int nextLevel() const { return 0; }
+        void start();
+    private:
+        const QString m_parent;
+        QXmlAttributes m_atts;
+        QString m_class;
+        bool m_empty;
+    };
+
+    class StyleHandler : public NodeHandler
+    {
+    public:
+        explicit StyleHandler(FbNormHandler &owner, const QString &name);
+    protected:
+        virtual void TxtTag(const QString &text);
+        virtual void EndTag(const QString &name);
+    private:
+        FbNormHandler &m_owner;
+        QString m_text;
+    };
+
+    class BinaryHandler : public NodeHandler
+    {
+    public:
+        explicit BinaryHandler(FbNormHandler &owner, const QString &name, const QXmlAttributes &atts);
+    protected:
+        virtual void TxtTag(const QString &text);
+        virtual void EndTag(const QString &name);
+    private:
+        FbNormHandler &m_owner;
+        const QString m_file;
+        const QString m_type;
+        const bool m_defer;
+        bool m_started;
+        QString m_data;
+    };
+
+    struct Binary {
+        QString file;
+        QString type;
+        QString data;
+    };
+
+protected:
+    virtual NodeHandler * CreateRoot(const QString &name, const QXmlAttributes &atts);
+
+private:
+    void writeStartElement(const QString &name, int level);
+    void writeEndElement(int level);
+    void writeLineEnd();
+    void writeBinaryStart(const QString &file, const QString &type, const QString &data);
+    void writeBinaryData(QString &data, bool all);
+    void writeBinaryEnd();
+
+private:
+    QXmlStreamWriter m_writer;
+    QSet<QString> m_names;
+    QList<Binary> m_deferred;
+    QString m_message;
+};
+
+#endif // FB2NORM_H
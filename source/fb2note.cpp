@@ -5,6 +5,7 @@
 #include <QHeaderView>
 #include <QLabel>
 #include <QLineEdit>
+#include <QSet>
 #include <QSplitter>
 #include <QToolBar>
 #include <QWebFrame>
@@ -14,8 +15,152 @@
 #include "fb2list.hpp"
 #include "fb2page.hpp"
 #include "fb2text.hpp"
+#include "fb2trace.h"
 #include "fb2html.h"
 
+//---------------------------------------------------------------------------
+//  FbNoteIndex
+//---------------------------------------------------------------------------
+
+FbNoteIndex::FbNoteIndex(FbTextPage *page)
+    : m_page(page)
+    , m_listed(false)
+    , m_revision(-1)
+    , m_serial(0)
+{
+}
+
+void FbNoteIndex::clear()
+{
+    m_anchorNodes.clear();
+    m_targetNodes.clear();
+    m_elements.clear();
+    m_targets.clear();
+    m_refs.clear();
+    m_anchors.clear();
+    m_ids.clear();
+    m_listed = false;
+    m_revision = -1;
+}
+
+// The whole book is read once per load, later only the anchors and sections
+// that notes.js saw change cross over. Entries come as node, kind, attached,
+// href or id, type, text; every section entry also hands its element over.
+void FbNoteIndex::update()
+{
+    QWebFrame *frame = m_page->mainFrame();
+    int revision = frame->evaluateJavaScript("fbNotesRevision").toInt();
+    if (revision == m_revision) return;
+
+    FB2_TRACE("FbNoteIndex::update");
+    QString script = m_revision < 0 ? "fbNotesIndex()" : "fbNotesDelta()";
+    m_revision = revision;
+    m_serial++;
+    m_listed = false;
+
+    m_page->nodes().takeAll();
+    QVariantList list = frame->evaluateJavaScript(script).toList();
+    QList<QWebElement> elements = m_page->nodes().takeAll();
+
+    for (int i = 0; i + 5 < list.count(); i += 6) {
+        int node = list.at(i).toInt();
+        bool attached = list.at(i + 2).toBool();
+        QString key = list.at(i + 3).toString();
+        if (list.at(i + 1).toString() == "a") {
+            removeAnchor(node);
+            if (!attached) continue;
+            Anchor anchor;
+            anchor.node = node;
+            anchor.href = key;
+            anchor.type = list.at(i + 4).toString();
+            anchor.text = list.at(i + 5).toString();
+            m_anchorNodes.insert(node, anchor);
+            if (key.startsWith('#')) m_refs.insert(key.mid(1), node);
+        } else {
+            QWebElement element = elements.isEmpty() ? QWebElement() : elements.takeFirst();
+            removeTarget(node);
+            if (!attached || key.isEmpty()) continue;
+            m_targetNodes.insert(node, key);
+            m_targets.insert(key, node);
+            m_elements.insert(node, element);
+        }
+    }
+}
+
+void FbNoteIndex::removeAnchor(int node)
+{
+    if (!m_anchorNodes.contains(node)) return;
+    QString href = m_anchorNodes.take(node).href;
+    if (href.startsWith('#')) m_refs.remove(href.mid(1), node);
+}
+
+void FbNoteIndex::removeTarget(int node)
+{
+    if (!m_targetNodes.contains(node)) return;
+    m_targets.remove(m_targetNodes.take(node), node);
+    m_elements.remove(node);
+}
+
+// Lists follow node ids, which is document order for everything read at load
+void FbNoteIndex::list()
+{
+    if (m_listed) return;
+    m_listed = true;
+    m_anchors = m_anchorNodes.values();
+    m_ids.clear();
+    QSet<QString> ids;
+    foreach (const QString &id, m_targetNodes) {
+        if (ids.contains(id)) continue;
+        ids.insert(id);
+        m_ids << id;
+    }
+}
+
+int FbNoteIndex::revision()
+{
+    update();
+    return m_serial;
+}
+
+QStringList FbNoteIndex::changed()
+{
+    QString result = m_page->mainFrame()->evaluateJavaScript("fbNotesChanged()").toString();
+    return result.split(",", QString::SkipEmptyParts);
+}
+
+// Previews need the geometry of a laid out section, evicted targets have none
+FbTextElement FbNoteIndex::target(const QString &id)
+{
+    update();
+    QList<int> nodes = m_targets.values(id);
+    qSort(nodes);
+    foreach (int node, nodes) {
+        FbTextElement element = m_elements.value(node);
+        if (!element.geometry().isEmpty()) return element;
+    }
+    return FbTextElement();
+}
+
+QList<int> FbNoteIndex::anchors(const QString &id)
+{
+    update();
+    return m_refs.values(id);
+}
+
+const FbNoteIndex::AnchorList & FbNoteIndex::anchors()
+{
+    update();
+    list();
+    return m_anchors;
+}
+
+QStringList FbNoteIndex::targets()
+{
+    update();
+    list();
+    return m_ids;
+}
+
 //---------------------------------------------------------------------------
 //  FbNoteDlg
 //---------------------------------------------------------------------------
@@ -72,6 +217,9 @@ FbNoteDlg::FbNoteDlg(FbTextBase *text)
     QObject::connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
 
     m_key->addItem(tr("<create new>"));
+    if (FbTextPage *owner = qobject_cast<FbTextPage*>(text->page())) {
+        m_key->addItems(owner->notes().targets());
+    }
     m_key->setCurrentIndex(0);
     m_title->setFocus();
 
@@ -97,16 +245,27 @@ void FbNoteDlg::loadFinished()
 
 FbNotesModel::FbNotesModel(FbTextPage *page, QObject *parent)
     : QAbstractListModel(parent)
-    , collection(page->body().findAll("a"))
+    , m_list(page->notes().anchors())
     , m_page(page)
+    , m_revision(page->notes().revision())
+{
+}
+
+void FbNotesModel::update()
 {
+    FbNoteIndex &notes = m_page->notes();
+    if (notes.revision() == m_revision) return;
+    beginResetModel();
+    m_list = notes.anchors();
+    m_revision = notes.revision();
+    endResetModel();
 }
 
 FbTextElement FbNotesModel::at(const QModelIndex &index) const
 {
     int row = index.row();
-    if (row < 0 || row >= collection.count()) return QWebElement();
-    return collection.at(row);
+    if (row < 0 || row >= m_list.count()) return QWebElement();
+    return m_page->element(m_list.at(row).node);
 }
 
 int FbNotesModel::columnCount(const QModelIndex &parent) const
@@ -117,7 +276,7 @@ int FbNotesModel::columnCount(const QModelIndex &parent) const
 
 int FbNotesModel::rowCount(const QModelIndex &parent) const
 {
-    return parent.isValid() ? 0 : collection.count();
+    return parent.isValid() ? 0 : m_list.count();
 }
 
 QVariant FbNotesModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -137,11 +296,13 @@ QVariant FbNotesModel::data(const QModelIndex &index, int role) const
     if (index.isValid()) {
         switch (role) {
             case Qt::DisplayRole: {
-                QWebElement element = at(index);
+                int row = index.row();
+                if (row < 0 || row >= m_list.count()) return QVariant();
+                const FbNoteIndex::Anchor &anchor = m_list.at(row);
                 switch (index.column()) {
-                    case 1: return element.toPlainText();
-                    case 2: return element.attribute("type");
-                    default: return element.attribute("href");
+                    case 1: return anchor.text;
+                    case 2: return anchor.type;
+                    default: return anchor.href;
                 }
             } break;
             case Qt::TextAlignmentRole: {
@@ -182,6 +343,10 @@ FbNotesWidget::FbNotesWidget(FbTextEdit *text, QWidget* parent)
 
     layout->addWidget(splitter);
 
+    m_timer.setInterval(500);
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), SLOT(updateList()));
+
     connect(m_text, SIGNAL(loadFinished(bool)), SLOT(loadFinished()));
     connect(m_list, SIGNAL(showCurrent(QString)), SLOT(showCurrent(QString)));
     connect(m_list, SIGNAL(activated(QModelIndex)), SLOT(activated(QModelIndex)));
@@ -202,6 +367,14 @@ void FbNotesWidget::loadFinished()
     m_list->setModel(new FbNotesModel(m_text->page(), this));
     m_list->reset();
     m_list->setColumnHidden(0, true);
+    connect(m_text->page(), SIGNAL(contentsChanged()), &m_timer, SLOT(start()), Qt::UniqueConnection);
+}
+
+void FbNotesWidget::updateList()
+{
+    if (FbNotesModel *m = qobject_cast<FbNotesModel*>(m_list->model())) {
+        m->update();
+    }
 }
 
 void FbNotesWidget::showCurrent(const QString &name)
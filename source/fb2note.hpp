@@ -3,7 +3,11 @@
 
 #include <QAbstractListModel>
 #include <QDialog>
+#include <QHash>
 #include <QList>
+#include <QMap>
+#include <QStringList>
+#include <QTimer>
 #include <QTreeView>
 #include <QWebElement>
 #include <QWebElementCollection>
@@ -12,6 +16,7 @@ QT_BEGIN_NAMESPACE
 class QComboBox;
 class QLineEdit;
 class QToolBar;
+class QWebPage;
 class QWebView;
 QT_END_NAMESPACE
 
@@ -21,6 +26,47 @@ class FbTextEdit;
 
 #include "fb2html.h"
 
+class FbNoteIndex
+{
+public:
+    struct Anchor {
+        int node;
+        QString href;
+        QString type;
+        QString text;
+    };
+    typedef QList<Anchor> AnchorList;
+
+public:
+    explicit FbNoteIndex(FbTextPage *page);
+    FbTextElement target(const QString &id);
+    QList<int> anchors(const QString &id);
+    const AnchorList & anchors();
+    QStringList targets();
+    QStringList changed();
+    int revision();
+    void clear();
+
+private:
+    void update();
+    void list();
+    void removeAnchor(int node);
+    void removeTarget(int node);
+
+private:
+    FbTextPage *m_page;
+    QMap<int, Anchor> m_anchorNodes;
+    QMap<int, QString> m_targetNodes;
+    QHash<int, FbTextElement> m_elements;
+    QMultiHash<QString, int> m_targets;
+    QMultiHash<QString, int> m_refs;
+    AnchorList m_anchors;
+    QStringList m_ids;
+    bool m_listed;
+    int m_revision;
+    int m_serial;
+};
+
 class FbNoteDlg : public QDialog
 {
     Q_OBJECT
@@ -45,6 +91,7 @@ class FbNotesModel : public QAbstractListModel
 public:
     explicit FbNotesModel(FbTextPage *page, QObject *parent = 0);
     FbTextElement at(const QModelIndex &index) const;
+    void update();
 
 public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
@@ -53,8 +100,9 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 
 private:
-    QWebElementCollection collection;
+    FbNoteIndex::AnchorList m_list;
     FbTextPage *m_page;
+    int m_revision;
 };
 
 class FbNotesWidget : public QWidget
@@ -69,11 +117,13 @@ private slots:
     void activated(const QModelIndex &index);
     void showCurrent(const QString &name);
     void loadFinished();
+    void updateList();
 
 private:
     FbTextEdit *m_text;
     QTreeView *m_list;
     QWebView *m_view;
+    QTimer m_timer;
 };
 
 #endif // FB2NOTE_H
@@ -1,11 +1,14 @@
 #include "fb2page.hpp"
 
+#include <QSet>
+#include <QSettings>
 #include <QTimer>
 #include <QWebFrame>
 #include <QtDebug>
 
 #include "fb2read.hpp"
 #include "fb2save.hpp"
+#include "fb2trace.h"
 #include "fb2imgs.hpp"
 #include "fb2utils.h"
 #include "fb2html.h"
@@ -20,6 +23,24 @@ void FbTextLogger::trace(const QString &text)
     qCritical() << text;
 }
 
+//---------------------------------------------------------------------------
+//  FbTextNodes
+//---------------------------------------------------------------------------
+
+QWebElement FbTextNodes::take()
+{
+    QWebElement result = m_elements.isEmpty() ? QWebElement() : m_elements.first();
+    m_elements.clear();
+    return result;
+}
+
+QList<QWebElement> FbTextNodes::takeAll()
+{
+    QList<QWebElement> result = m_elements;
+    m_elements.clear();
+    return result;
+}
+
 //---------------------------------------------------------------------------
 //  FbTextPage
 //---------------------------------------------------------------------------
@@ -27,6 +48,13 @@ void FbTextLogger::trace(const QString &text)
 FbTextPage::FbTextPage(QObject *parent)
     : QWebPage(parent)
     , m_logger(this)
+    , m_nodes(this)
+    , m_notes(this)
+    , m_htmlBytes(0)
+    , m_undoBudget(64)
+    , m_virtualLimit(10000)
+    , m_traceLoad(0)
+    , m_cleanLost(false)
 {
     QWebSettings *s = settings();
     s->setAttribute(QWebSettings::AutoLoadImages, true);
@@ -44,8 +72,26 @@ FbTextPage::FbTextPage(QObject *parent)
     setContentEditable(true);
     setNetworkAccessManager(new FbNetworkAccessManager(this));
     connect(this, SIGNAL(loadFinished(bool)), SLOT(loadFinished()));
-    connect(this, SIGNAL(contentsChanged()), SLOT(fixContents()));
-    connect(this, SIGNAL(selectionChanged()), SLOT(showStatus()));
+    connect(mainFrame(), SIGNAL(javaScriptWindowObjectCleared()), SLOT(windowCleared()));
+    connect(this, SIGNAL(selectionChanged()), &m_statusTimer, SLOT(start()));
+    connect(&m_statusTimer, SIGNAL(timeout()), SLOT(showStatus()));
+    m_statusTimer.setSingleShot(true);
+    m_statusTimer.setInterval(16);
+    connect(this, SIGNAL(contentsChanged()), &m_checkTimer, SLOT(start()));
+    connect(&m_checkTimer, SIGNAL(timeout()), SLOT(checkScheme()));
+    m_checkTimer.setSingleShot(true);
+    m_checkTimer.setInterval(250);
+
+    QSettings settings;
+    int budget = settings.value("undoBudget", m_undoBudget).toInt();
+    if (budget > 0) m_undoBudget = budget;
+    m_virtualLimit = settings.value("virtualLimit", m_virtualLimit).toInt();
+}
+
+FbTextPage::~FbTextPage()
+{
+    // Some commands release page data, run them while the frame is still alive
+    undoStack()->clear();
 }
 
 QUrl FbTextPage::getStyleSheetUrl()
@@ -82,6 +128,15 @@ bool FbTextPage::read(QIODevice *device)
 
 void FbTextPage::html(const QString &html, FbStore *store)
 {
+    FB2_TRACE("FbTextPage::html");
+    m_traceLoad = FbTrace::enabled() ? FbTrace::now() : 0;
+    m_cleanLost = false;
+    // The frame keeps the source as UTF-8 while the document lives, Cyrillic takes two bytes a character
+    m_htmlBytes = html.size();
+    foreach (QChar ch, html) {
+        ushort code = ch.unicode();
+        if (code >= 0x80) m_htmlBytes += code >= 0x800 ? 2 : 1;
+    }
     QWebSettings::clearMemoryCaches();
     QUrl url = FbTextPage::createUrl();
     manager()->setStore(url, store);
@@ -132,9 +187,50 @@ FbTextElement FbTextPage::doc()
 
 void FbTextPage::push(QUndoCommand * command, const QString &text)
 {
-    undoStack()->beginMacro(text);
-    undoStack()->push(command);
-    undoStack()->endMacro();
+    QUndoStack *stack = undoStack();
+    qint64 total = undoBytes(command);
+    // Commands past the current index are discarded by the push itself
+    for (int i = 0; i < stack->index(); ++i) total += undoBytes(stack->command(i));
+    if (total > qint64(m_undoBudget) << 20 && stack->index()) {
+        // QUndoStack has no way to drop only the oldest commands, and clear()
+        // moves the clean index to the empty stack, which is not the saved book
+        m_cleanLost = true;
+        stack->clear();
+        emit status(tr("Undo history exceeded %1 MB and was cleared").arg(m_undoBudget));
+    }
+    stack->beginMacro(text);
+    stack->push(command);
+    stack->endMacro();
+    m_checkTimer.start();
+}
+
+void FbTextPage::setClean()
+{
+    m_cleanLost = false;
+    undoStack()->setClean();
+}
+
+int FbTextPage::undoBytes(const QUndoCommand *command)
+{
+    if (!command) return 0;
+    const FbUndoCommand *undo = dynamic_cast<const FbUndoCommand*>(command);
+    int bytes = undo ? undo->bytes() : int(sizeof(QUndoCommand));
+    int count = command->childCount();
+    for (int i = 0; i < count; ++i) bytes += undoBytes(command->child(i));
+    return bytes;
+}
+
+qint64 FbTextPage::pendingBytes() const
+{
+    qint64 bytes = 0;
+    foreach (FbReadThread *thread, findChildren<FbReadThread*>()) bytes += thread->bytes();
+    return bytes;
+}
+
+QVariantMap FbTextPage::memory()
+{
+    FB2_TRACE("js:fbMemory");
+    return mainFrame()->evaluateJavaScript("fbMemory()").toMap();
 }
 
 void FbTextPage::update()
@@ -306,20 +402,22 @@ void FbTextPage::insertText()
 void FbTextPage::createBlock(const QString &name)
 {
     QString style = name;
-    QString js1 = jScript("section_get.js");
-    QString result = mainFrame()->evaluateJavaScript(js1).toString();
+    QString result = mainFrame()->evaluateJavaScript("fbSectionGet()").toString();
     QStringList list = result.split("|");
     if (list.count() < 2) return;
-    const QString location = list[0];
-    const QString position = list[1];
-    if (style == "title" && position.left(2) != "0,") style.prepend("sub");
-    FbTextElement original = element(location);
-    FbTextElement duplicate = original.clone();
-    original.appendOutside(duplicate);
-    original.takeFromDocument();
-    QString js2 = jScript("section_new.js") + ";f(this,'fb:%1',%2)";
-    duplicate.evaluateJavaScript(js2.arg(style).arg(position));
-    QUndoCommand * command = new FbReplaceCmd(original, duplicate);
+    const int id = list[0].toInt();
+    QStringList position = list[1].split(",");
+    if (position.count() < 2) return;
+    int start = position[0].toInt();
+    int end = position[1].toInt();
+    if (start < 0 || end < start) return;
+    if (style == "title" && start) style.prepend("sub");
+    FbTextElement parent = element(id);
+    FbTextElement first = parent.child(start);
+    if (first.isNull()) return;
+    first.prependOutside(QString("<fb:%1></fb:%1>").arg(style));
+    FbTextElement wrapper = first.previousSibling();
+    QUndoCommand * command = new FbWrapCmd(wrapper, end - start + 1);
     push(command, tr("Create <%1>").arg(style));
 }
 
@@ -334,24 +432,8 @@ void FbTextPage::deleteSection()
     while (!element.isNull()) {
         if (element.isSection()) {
             if (element.parent().isBody()) return;
-            FbTextElement original = element.parent();
-            FbTextElement duplicate = original.clone();
-            int index = element.index();
-            original.appendOutside(duplicate);
-            original.takeFromDocument();
-            element = duplicate.child(index);
-            if (index) {
-                FbTextElement title = element.firstChild();
-                if (title.isTitle()) {
-                    title.removeClass("title");
-                    title.addClass("subtitle");
-                }
-            }
-            QString xml = element.toInnerXml();
-            element.setOuterXml(xml);
-            QUndoCommand * command = new FbReplaceCmd(original, duplicate);
+            QUndoCommand * command = new FbUnwrapCmd(element);
             push(command, tr("Remove section"));
-            element.select();
             break;
         }
         element = element.parent();
@@ -365,53 +447,98 @@ void FbTextPage::createTitle()
 
 FbTextElement FbTextPage::current()
 {
-    return element(location());
+    return element(mainFrame()->evaluateJavaScript("fbCurrent()").toInt());
 }
 
-FbTextElement FbTextPage::element(const QString &location)
+// Ids live in JS only, fbElement() hands the node from fbNodes back through m_nodes.
+// A node of an evicted section is materialized first.
+FbTextElement FbTextPage::element(int id)
 {
-    if (location.isEmpty()) return FbTextElement();
-    QStringList list = location.split(",", QString::SkipEmptyParts);
-    QStringListIterator iterator(list);
-    QWebElement result = doc();
-    while (iterator.hasNext()) {
-        QString str = iterator.next();
-        int pos = str.indexOf("=");
-        QString tag = str.left(pos);
-        int key = str.mid(pos + 1).toInt();
-        if (key < 0) break;
-        result = result.firstChild();
-        while (0 < key--) result = result.nextSibling();
-    }
-    return result;
+    if (id <= 0) return FbTextElement();
+    mainFrame()->evaluateJavaScript(QString("fbElement(%1)").arg(id));
+    return m_nodes.take();
 }
 
-QString FbTextPage::location()
+QList<int> FbTextPage::nodePath()
 {
-    QString javascript = "location(document.getSelection().anchorNode)";
-    return mainFrame()->evaluateJavaScript(javascript).toString();
+    QString javascript = "fbPath(document.getSelection().anchorNode)";
+    QString path = mainFrame()->evaluateJavaScript(javascript).toString();
+    QList<int> result;
+    foreach (const QString &id, path.split(",", QString::SkipEmptyParts)) result << id.toInt();
+    return result;
 }
 
 void FbTextPage::showStatus()
 {
-    QString javascript = jScript("get_status.js");
-    QString text = mainFrame()->evaluateJavaScript(javascript).toString();
+    QString text = mainFrame()->evaluateJavaScript("status()").toString();
     text.replace("FB:", "");
     emit status(text);
 }
 
-void FbTextPage::loadFinished()
+// Scripts called on demand, read once and installed as functions on every load
+const QString & FbTextPage::scripts()
 {
-    mainFrame()->addToJavaScriptWindowObject("logger", &m_logger);
-    body().select();
+    static const QString bundle
+        = jScript("export.js")
+        + jScript("section_get.js")
+        + jScript("set_cursor.js");
+    return bundle;
 }
 
-void FbTextPage::fixContents()
+void FbTextPage::windowCleared()
 {
-    foreach (QWebElement span, doc().findAll("span.apple-style-span[style]")) {
-        span.removeAttribute("style");
+    mainFrame()->addToJavaScriptWindowObject("fbNodeBridge", &m_nodes);
+    // Books with more paragraphs keep far sections out of the layout
+    mainFrame()->evaluateJavaScript(QString("fbVirtualLimit=%1").arg(m_virtualLimit));
+}
+
+void FbTextPage::checkScheme()
+{
+    checkScheme(false);
+}
+
+void FbTextPage::checkScheme(bool all)
+{
+    FB2_TRACE("js:fbCheck");
+    QVariantList list = mainFrame()->evaluateJavaScript(QString("fbCheck(%1)").arg(all ? "true" : "false")).toList();
+
+    QSet<int> changed;
+    if (all) {
+        changed = m_violations.keys().toSet();
+        m_violations.clear();
     }
-    foreach (QWebElement span, doc().findAll("[style]")) {
-        span.removeAttribute("style");
+
+    for (int i = 0; i + 1 < list.count(); i += 2) {
+        int id = list.at(i).toInt();
+        QString text = list.at(i + 1).toString();
+        if (m_violations.value(id) == text) continue;
+        if (text.isEmpty()) {
+            m_violations.remove(id);
+        } else {
+            m_violations.insert(id, text);
+            if (!all) emit warning(0, 0, tr("Structure: %1").arg(text));
+        }
+        changed << id;
     }
+
+    // A large book may break the rules thousands of times, the markers show each place
+    if (all && !m_violations.isEmpty()) {
+        emit warning(0, 0, tr("Structure: %n problem(s) found", 0, m_violations.count()));
+    }
+
+    foreach (int id, changed) emit marked(id);
+}
+
+void FbTextPage::loadFinished()
+{
+    // Recording may have been switched on after the load started
+    if (FbTrace::enabled() && m_traceLoad) FbTrace::record("WebKit load", m_traceLoad, FbTrace::now());
+    m_traceLoad = 0;
+    FB2_TRACE("FbTextPage::loadFinished");
+    mainFrame()->addToJavaScriptWindowObject("logger", &m_logger);
+    mainFrame()->evaluateJavaScript(scripts());
+    mainFrame()->evaluateJavaScript(FbTextElement::schemeScript());
+    checkScheme(true);
+    m_notes.clear();
+    body().select();
 }
@@ -2,7 +2,10 @@
 #define FB2PAGE_HPP
 
 #include <QAction>
+#include <QHash>
+#include <QTimer>
 #include <QUndoCommand>
+#include <QWebElement>
 #include <QWebPage>
 
 class FbStore;
@@ -11,6 +14,7 @@ class FbNetworkAccessManager;
 
 #include "fb2logs.hpp"
 #include "fb2mode.h"
+#include "fb2note.hpp"
 
 class FbTextLogger : public QObject
 {
@@ -24,19 +28,45 @@ public slots:
 
 };
 
+class FbTextNodes : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FbTextNodes(QObject *parent = 0) : QObject(parent) {}
+    QWebElement take();
+    QList<QWebElement> takeAll();
+
+public slots:
+    void hand(const QWebElement &element) { m_elements << element; }
+
+private:
+    QList<QWebElement> m_elements;
+};
+
 class FbTextPage : public QWebPage
 {
     Q_OBJECT
 
 public:
     explicit FbTextPage(QObject *parent = 0);
+    virtual ~FbTextPage();
     FbNetworkAccessManager *manager();
     bool read(const QString &html);
     bool read(QIODevice *device);
     void push(QUndoCommand * command, const QString &text = QString());
-    FbTextElement element(const QString &location);
+    FbTextElement element(int id);
     FbTextElement current();
-    QString location();
+    QList<int> nodePath();
+    static int undoBytes(const QUndoCommand *command);
+    bool cleanLost() const { return m_cleanLost; }
+    void setClean();
+    qint64 htmlBytes() const { return m_htmlBytes; }
+    qint64 pendingBytes() const;
+    QVariantMap memory();
+    FbNoteIndex & notes() { return m_notes; }
+    FbTextNodes & nodes() { return m_nodes; }
+    QString violations(int id) const { return m_violations.value(id); }
 
     FbTextElement body();
     FbTextElement doc();
@@ -51,6 +81,7 @@ signals:
     void warning(int row, int col, const QString &msg);
     void error(int row, int col, const QString &msg);
     void fatal(int row, int col, const QString &msg);
+    void marked(int id);
 
 public slots:
     void html(const QString &html, FbStore *store);
@@ -81,16 +112,28 @@ protected:
 
 private slots:
     void loadFinished();
-    void fixContents();
+    void windowCleared();
     void showStatus();
+    void checkScheme();
 
 private:
     QUrl getStyleSheetUrl();
+    static const QString & scripts();
+    void checkScheme(bool all);
 
 private:
     FbActionMap m_actions;
     FbTextLogger m_logger;
-    QString m_html;
+    FbTextNodes m_nodes;
+    FbNoteIndex m_notes;
+    QTimer m_statusTimer;
+    QTimer m_checkTimer;
+    QHash<int, QString> m_violations;
+    qint64 m_htmlBytes;
+    int m_undoBudget;
+    int m_virtualLimit;
+    qint64 m_traceLoad;
+    bool m_cleanLost;
 };
 
 #endif // FB2PAGE_HPP
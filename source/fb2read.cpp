@@ -3,6 +3,7 @@
 #include <QtDebug>
 
 #include "fb2imgs.hpp"
+#include "fb2trace.h"
 #include "fb2xml2.h"
 
 //---------------------------------------------------------------------------
@@ -32,7 +33,14 @@ FbReadThread::~FbReadThread()
 
 void FbReadThread::run()
 {
-    if (parse()) {
+    bool ok;
+    {
+        FB2_TRACE("FbReadThread::parse");
+        ok = parse();
+    }
+    if (ok) {
+        m_bytes = m_html.size() * int(sizeof(QChar));
+        FbTrace::instant("FbReadThread::html");
         emit html(m_html, m_store);
     } else {
         delete m_store;
@@ -205,6 +213,12 @@ void FbReadHandler::RootHandler::writeHeader()
 
     writeScript("qrc:/js/jquery.js");
     writeScript("qrc:/js/location.js");
+    writeScript("qrc:/js/fix_contents.js");
+    writeScript("qrc:/js/notes.js");
+    writeScript("qrc:/js/replace.js");
+    writeScript("qrc:/js/undo.js");
+    writeScript("qrc:/js/virtual.js");
+    writeScript("qrc:/js/check.js");
     if (!m_style.isEmpty()) {
         writer().writeStartElement("style");
         writer().writeAttribute("type", "text/css");
@@ -3,6 +3,7 @@
 
 #include "fb2xml.hpp"
 
+#include <QAtomicInt>
 #include <QByteArray>
 #include <QMutex>
 #include <QThread>
@@ -17,6 +18,7 @@ class FbReadThread : public QThread
 public:
     static void execute(QObject *parent, QXmlInputSource *source, QIODevice *device);
     ~FbReadThread();
+    int bytes() const { return m_bytes; }
 
 signals:
     void binary(const QString &name, const QByteArray &data);
@@ -35,6 +37,7 @@ private:
     QXmlInputSource *m_source;
     FbStore *m_store;
     QString m_html;
+    QAtomicInt m_bytes;
 };
 
 class FbReadHandler : public FbXmlHandler
@@ -4,6 +4,7 @@
 #include "fb2page.hpp"
 #include "fb2save.hpp"
 #include "fb2text.hpp"
+#include "fb2trace.h"
 #include "fb2utils.h"
 #include "fb2html.h"
 
@@ -572,6 +573,7 @@ void FbSaveHandler::setDocumentInfo(QWebFrame * frame)
 
 bool FbSaveHandler::save()
 {
+    FB2_TRACE("FbSaveHandler::save");
     FbTextPage *page = m_writer.view().page();
     if (!page) return false;
 
@@ -580,9 +582,13 @@ bool FbSaveHandler::save()
 
     m_writer.writeStartDocument();
     if (page->isModified()) setDocumentInfo(frame);
-    QString javascript = jScript("export.js");
     frame->addToJavaScriptWindowObject("handler", this);
-    frame->evaluateJavaScript(javascript);
+    frame->evaluateJavaScript("fbVirtualSuspend()");
+    {
+        FB2_TRACE("js:export");
+        frame->evaluateJavaScript("fbExport(document)");
+    }
+    frame->evaluateJavaScript("fbVirtualResume()");
     m_writer.writeEndDocument();
 
     return true;
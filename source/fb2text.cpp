@@ -6,16 +6,20 @@
 #include <QInputDialog>
 #include <QMainWindow>
 #include <QMenu>
+#include <QTextDocument>
 #include <QToolBar>
+#include <QUndoStack>
 #include <QWebInspector>
 #include <QWebFrame>
 #include <QWebPage>
 #include <QtDebug>
 
 #include "fb2dlgs.hpp"
+#include "fb2find.hpp"
 #include "fb2note.hpp"
 #include "fb2page.hpp"
 #include "fb2save.hpp"
+#include "fb2trace.h"
 #include "fb2tree.hpp"
 #include "fb2utils.h"
 
@@ -85,36 +89,80 @@ FbDockWidget::FbDockWidget(const QString &title, QWidget *parent, Qt::WindowFlag
 //  FbNoteView
 //---------------------------------------------------------------------------
 
-class FbNoteView : public QWebView
-{
-public:
-    explicit FbNoteView(QWidget *parent, const QUrl &url);
-    void hint(const QWebElement element, const QRect &rect);
-protected:
-    void paintEvent(QPaintEvent *event);
-    const QUrl m_url;
-};
-
 FbNoteView::FbNoteView(QWidget *parent, const QUrl &url)
     : QWebView(parent)
     , m_url(url)
+    , m_cache(16384)
+    , m_revision(0)
 {
+    connect(this, SIGNAL(loadFinished(bool)), SLOT(cacheNote(bool)));
 }
 
 void FbNoteView::paintEvent(QPaintEvent *event)
 {
-    QWebView::paintEvent(event);
+    if (m_pixmap.isNull()) {
+        QWebView::paintEvent(event);
+    }
     QPainter painter(this);
+    if (!m_pixmap.isNull()) painter.drawPixmap(0, 0, m_pixmap);
     painter.setPen(Qt::black);
     QSize size = geometry().size() - QSize(1, 1);
     painter.drawRect( QRect(QPoint(0, 0), size) );
 }
 
+void FbNoteView::invalidate(int revision, const QStringList &ids)
+{
+    if (m_revision != revision) {
+        m_revision = revision;
+        m_cache.clear();
+        m_pending.clear();
+    }
+    foreach (const QString &id, ids) {
+        m_cache.remove(id);
+        if (m_pending == id) m_pending.clear();
+    }
+}
+
+// The rendered note carries its id, a load finishing after a newer hover is not cached
+void FbNoteView::cacheNote(bool ok)
+{
+    if (!ok || m_pending.isEmpty()) return;
+    QString id = page()->mainFrame()->findFirstElement("body").attribute("fbnote");
+    if (id != m_pending) return;
+    QPixmap * pixmap = new QPixmap(size());
+    QPainter painter(pixmap);
+    page()->mainFrame()->render(&painter);
+    painter.end();
+    int cost = pixmap->width() * pixmap->height() * pixmap->depth() / 8192;
+    m_cache.insert(m_pending, pixmap, cost);
+    m_pending.clear();
+}
+
 void FbNoteView::hint(const QWebElement element, const QRect &rect)
 {
+    const QString id = element.attribute("id");
+    setGeometry(rect);
+
+    if (QPixmap * pixmap = m_cache.object(id)) {
+        if (pixmap->size() == rect.size()) {
+            m_pending.clear();
+            m_pixmap = *pixmap;
+            update();
+            show();
+            return;
+        }
+    }
+
+    m_pixmap = QPixmap();
+    if (!id.isEmpty() && m_pending == id) {
+        show();
+        return;
+    }
+
+    m_pending = id;
     QString html = element.toOuterXml();
     html.prepend(
-        "<body bgcolor=lightyellow style='overflow:hidden;padding:0;margin:0;margin-top:2;'>"
+        "<body bgcolor=lightyellow style='overflow:hidden;padding:0;margin:0;margin-top:2;' fbnote=\"" + Qt::escape(id) + "\">"
         "<fb:body name=notes style='padding:0;margin:0;'>"
     );
     html.append("</fb:body></body>");
@@ -123,6 +171,43 @@ void FbNoteView::hint(const QWebElement element, const QRect &rect)
     show();
 }
 
+//---------------------------------------------------------------------------
+//  FbUndoView
+//---------------------------------------------------------------------------
+
+FbUndoView::FbUndoView(QUndoStack *stack, QWidget *parent)
+    : QTreeWidget(parent)
+    , m_stack(stack)
+{
+    setColumnCount(2);
+    setHeaderLabels(QStringList() << tr("Command") << tr("Bytes"));
+    setRootIsDecorated(false);
+    connect(stack, SIGNAL(indexChanged(int)), SLOT(updateList()));
+    updateList();
+}
+
+void FbUndoView::updateList()
+{
+    clear();
+    int total = 0;
+    int count = m_stack->count();
+    for (int i = 0; i < count; ++i) {
+        const QUndoCommand *command = m_stack->command(i);
+        int bytes = FbTextPage::undoBytes(command);
+        total += bytes;
+        QTreeWidgetItem *item = new QTreeWidgetItem(this);
+        item->setText(0, command->text());
+        item->setText(1, QString::number(bytes));
+        item->setTextAlignment(1, Qt::AlignRight);
+        if (i >= m_stack->index()) item->setForeground(0, Qt::gray);
+    }
+    QTreeWidgetItem *item = new QTreeWidgetItem(this);
+    item->setText(0, tr("Total"));
+    item->setText(1, QString::number(total));
+    item->setTextAlignment(1, Qt::AlignRight);
+    resizeColumnToContents(0);
+}
+
 //---------------------------------------------------------------------------
 //  FbTextBase
 //---------------------------------------------------------------------------
@@ -216,6 +301,8 @@ FbTextEdit::FbTextEdit(QWidget *parent, QObject *owner)
     , dockNote(0)
     , dockImgs(0)
     , dockInsp(0)
+    , dockFind(0)
+    , dockUndo(0)
 {
     FbTextPage * p = new FbTextPage(this);
     setContextMenuPolicy(Qt::CustomContextMenu);
@@ -266,6 +353,7 @@ void FbTextEdit::connectActions(QToolBar *tool)
     }
 
     connect(act(Fb::EditFind), SIGNAL(triggered()), SLOT(find()));
+    connect(act(Fb::EditReplace), SIGNAL(triggered()), SLOT(replace()));
 
     connect(act(Fb::InsertImage), SIGNAL(triggered()), SLOT(insertImage()));
     connect(act(Fb::InsertLink), SIGNAL(triggered()), SLOT(insertLink()));
@@ -370,6 +458,17 @@ void FbTextEdit::exportHtml()
         }
     }
 }
+
+void FbTextEdit::viewUndo()
+{
+    if (!dockUndo) {
+        dockUndo = new FbDockWidget(tr("Undo memory"), this);
+        dockUndo->setWidget(new FbUndoView(page()->undoStack(), m_owner));
+        connect(dockUndo, SIGNAL(destroyed()), SLOT(undoDestroyed()));
+        m_owner->addDockWidget(Qt::RightDockWidgetArea, dockUndo);
+    }
+    dockUndo->show();
+}
 #endif // QT_DEBUG
 
 void FbTextEdit::viewContents(bool show)
@@ -467,6 +566,16 @@ void FbTextEdit::noteDestroyed()
     dockNote = 0;
 }
 
+void FbTextEdit::findDestroyed()
+{
+    dockFind = 0;
+}
+
+void FbTextEdit::undoDestroyed()
+{
+    dockUndo = 0;
+}
+
 FbNoteView & FbTextEdit::noteView()
 {
     if (m_noteView) return *m_noteView;
@@ -496,7 +605,7 @@ void FbTextEdit::mouseMoveEvent(QMouseEvent *event)
 
 void FbTextEdit::cleanChanged(bool clean)
 {
-    emit modificationChanged(!clean);
+    emit modificationChanged(!clean || page()->cleanLost());
 }
 
 void FbTextEdit::contextMenu(const QPoint &pos)
@@ -533,8 +642,8 @@ void FbTextEdit::linkHovered(const QString &link, const QString &title, const QS
         return;
     }
 
-    const QString query = QString("fb\\:section#%1").arg(href);
-    const QWebElement element = doc().findFirst(query);
+    FbNoteIndex & notes = page()->notes();
+    const QWebElement element = notes.target(href);
     if (element.isNull()) {
         if (m_noteView) m_noteView->hide();
         return;
@@ -549,6 +658,7 @@ void FbTextEdit::linkHovered(const QString &link, const QString &title, const QS
     int y = m_point.y();
     if ( y > h ) y = y - h - 10; else y = y + 10;
     QPoint point = QPoint(x, y) + rect.topLeft();
+    noteView().invalidate(notes.revision(), notes.changed());
     noteView().hint(element, QRect(point, size));
 }
 
@@ -557,7 +667,7 @@ bool FbTextEdit::save(QIODevice *device, const QString &codec)
     FbSaveWriter writer(*this, device);
     if (!codec.isEmpty()) writer.setCodec(codec.toLatin1());
     bool ok = FbSaveHandler(writer).save();
-    if (ok) page()->undoStack()->setClean();
+    if (ok) page()->setClean();
     return ok;
 }
 
@@ -578,7 +688,12 @@ bool FbTextEdit::save(QString *string, int &anchor, int &focus)
 
 QString FbTextEdit::toHtml()
 {
-    return page()->mainFrame()->toHtml();
+    FB2_TRACE("FbTextEdit::toHtml");
+    QWebFrame *frame = page()->mainFrame();
+    frame->evaluateJavaScript("fbVirtualSuspend()");
+    QString html = frame->toHtml();
+    frame->evaluateJavaScript("fbVirtualResume()");
+    return html;
 }
 
 void FbTextEdit::zoomIn()
@@ -637,8 +752,26 @@ bool FbTextEdit::SupChecked()
 
 void FbTextEdit::find()
 {
-    FbTextFindDlg dlg(*this);
-    dlg.exec();
+    search(false);
+}
+
+void FbTextEdit::replace()
+{
+    search(true);
+}
+
+void FbTextEdit::search(bool replace)
+{
+    if (!dockFind) {
+        dockFind = new FbDockWidget(tr("Search"), this);
+        dockFind->setWidget(new FbSearchWidget(this, m_owner));
+        connect(dockFind, SIGNAL(destroyed()), SLOT(findDestroyed()));
+        m_owner->addDockWidget(Qt::BottomDockWidgetArea, dockFind);
+    }
+    dockFind->show();
+    if (FbSearchWidget *widget = qobject_cast<FbSearchWidget*>(dockFind->widget())) {
+        widget->activate(selectedText(), replace);
+    }
 }
 
 void FbTextEdit::insertImage()
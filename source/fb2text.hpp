@@ -2,10 +2,13 @@
 #define FB2TEXT_H
 
 #include <QAction>
+#include <QCache>
 #include <QDockWidget>
 #include <QFrame>
+#include <QPixmap>
 #include <QResizeEvent>
 #include <QTimer>
+#include <QTreeWidget>
 #include <QWebElement>
 #include <QWebView>
 
@@ -15,9 +18,9 @@
 QT_BEGIN_NAMESPACE
 class QMainWindow;
 class QToolBar;
+class QUndoStack;
 QT_END_NAMESPACE
 
-class FbNoteView;
 class FbReadThread;
 class FbTextPage;
 
@@ -28,6 +31,43 @@ public:
     explicit FbDockWidget(const QString &title, QWidget *parent = 0, Qt::WindowFlags flags = 0);
 };
 
+class FbNoteView : public QWebView
+{
+    Q_OBJECT
+
+public:
+    explicit FbNoteView(QWidget *parent, const QUrl &url);
+    void hint(const QWebElement element, const QRect &rect);
+    void invalidate(int revision, const QStringList &ids);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private slots:
+    void cacheNote(bool ok);
+
+private:
+    const QUrl m_url;
+    QCache<QString, QPixmap> m_cache;
+    QPixmap m_pixmap;
+    QString m_pending;
+    int m_revision;
+};
+
+class FbUndoView : public QTreeWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FbUndoView(QUndoStack *stack, QWidget *parent = 0);
+
+private slots:
+    void updateList();
+
+private:
+    QUndoStack *m_stack;
+};
+
 class FbTextBase : public QWebView
 {
     Q_OBJECT
@@ -112,10 +152,12 @@ public slots:
     void insertNote();
     void insertLink();
     void find();
+    void replace();
 
 #ifdef QT_DEBUG
 public slots:
     void exportHtml();
+    void viewUndo();
 #endif // QT_DEBUG
 
 private slots:
@@ -125,6 +167,8 @@ private slots:
     void treeDestroyed();
     void imgsDestroyed();
     void noteDestroyed();
+    void findDestroyed();
+    void undoDestroyed();
     void zoomIn();
     void zoomOut();
     void zoomReset();
@@ -135,6 +179,7 @@ private:
     void execCommand(const QString &cmd, const QString &arg);
     FbBinary * file(const QString &name);
     FbNoteView & noteView();
+    void search(bool replace);
 
 private:
     QMainWindow *m_owner;
@@ -145,6 +190,8 @@ private:
     QDockWidget *dockNote;
     QDockWidget *dockImgs;
     QDockWidget *dockInsp;
+    QDockWidget *dockFind;
+    QDockWidget *dockUndo;
     QPoint m_point;
 };
 
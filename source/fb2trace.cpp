@@ -0,0 +1,133 @@
+#include "fb2trace.h"
+#include "fb2utils.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+//---------------------------------------------------------------------------
+//  FbTrace
+//---------------------------------------------------------------------------
+
+namespace {
+
+struct FbTraceEvent
+{
+    const char *name;
+    qint64 begin;
+    qint64 duration;
+    int thread;
+};
+
+// Spans beyond this are dropped, a forgotten recording must not eat the memory
+const int s_limit = 1000000;
+
+QMutex s_mutex;
+QElapsedTimer s_clock;
+QVector<FbTraceEvent> s_events;
+QHash<Qt::HANDLE, int> s_threads;
+QString s_filename;
+
+int threadIndex()
+{
+    Qt::HANDLE handle = QThread::currentThreadId();
+    QHash<Qt::HANDLE, int>::const_iterator it = s_threads.find(handle);
+    if (it != s_threads.end()) return it.value();
+    int index = s_threads.count() + 1;
+    s_threads.insert(handle, index);
+    return index;
+}
+
+}
+
+QAtomicInt FbTrace::s_enabled(0);
+
+void FbTrace::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&s_mutex);
+    Q_UNUSED(locker);
+    if (enabled && !s_clock.isValid()) s_clock.start();
+    s_enabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+// FB2_TRACE=<file> records from startup and writes the trace on exit
+void FbTrace::startup()
+{
+    s_filename = QString::fromLocal8Bit(qgetenv("FB2_TRACE"));
+    if (!s_filename.isEmpty()) setEnabled(true);
+}
+
+void FbTrace::shutdown()
+{
+    if (s_filename.isEmpty()) return;
+    save(s_filename);
+}
+
+qint64 FbTrace::now()
+{
+    return s_clock.isValid() ? s_clock.nsecsElapsed() / 1000 : 0;
+}
+
+void FbTrace::record(const char *name, qint64 begin, qint64 end)
+{
+    QMutexLocker locker(&s_mutex);
+    Q_UNUSED(locker);
+    if (s_events.count() >= s_limit) return;
+    FbTraceEvent event = { name, begin, end - begin, threadIndex() };
+    s_events.append(event);
+}
+
+void FbTrace::instant(const char *name)
+{
+    if (!enabled()) return;
+    // A negative duration marks an instant event
+    qint64 time = now();
+    record(name, time, time - 1);
+}
+
+int FbTrace::count()
+{
+    QMutexLocker locker(&s_mutex);
+    Q_UNUSED(locker);
+    return s_events.count();
+}
+
+void FbTrace::clear()
+{
+    QMutexLocker locker(&s_mutex);
+    Q_UNUSED(locker);
+    s_events.clear();
+}
+
+// Chrome trace-event format, open it in chrome://tracing
+bool FbTrace::save(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    QMutexLocker locker(&s_mutex);
+    Q_UNUSED(locker);
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (int i = 0; i < s_events.count(); ++i) {
+        const FbTraceEvent &event = s_events.at(i);
+        out << (i ? ",\n" : "\n");
+        out << "{\"name\":" << jsString(QString::fromLatin1(event.name));
+        out << ",\"cat\":\"fb2\",\"pid\":1,\"tid\":" << event.thread;
+        out << ",\"ts\":" << event.begin;
+        if (event.duration < 0) {
+            out << ",\"ph\":\"i\",\"s\":\"t\"}";
+        } else {
+            out << ",\"ph\":\"X\",\"dur\":" << event.duration << "}";
+        }
+    }
+    out << "\n]}\n";
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef FB2TRACE_H
+#define FB2TRACE_H
+
+#include <QAtomicInt>
+#include <QString>
+
+class FbTrace
+{
+public:
+    static bool enabled() { return s_enabled != 0; }
+    static void setEnabled(bool enabled);
+    static void startup();
+    static void shutdown();
+    static qint64 now();
+    static void record(const char *name, qint64 begin, qint64 end);
+    static void instant(const char *name);
+    static bool save(const QString &filename);
+    static int count();
+    static void clear();
+
+private:
+    // Read without the mutex by the reader thread and the batch workers
+    static QAtomicInt s_enabled;
+};
+
+class FbTraceSpan
+{
+public:
+    explicit FbTraceSpan(const char *name)
+        : m_name(FbTrace::enabled() ? name : 0), m_begin(m_name ? FbTrace::now() : 0) {}
+    ~FbTraceSpan()
+        { if (m_name) FbTrace::record(m_name, m_begin, FbTrace::now()); }
+
+private:
+    const char *m_name;
+    const qint64 m_begin;
+};
+
+#define FB2_TRACE_JOIN2(a, b) a##b
+#define FB2_TRACE_JOIN(a, b) FB2_TRACE_JOIN2(a, b)
+#define FB2_TRACE(name) FbTraceSpan FB2_TRACE_JOIN(fb2trace, __LINE__)(name)
+
+#endif // FB2TRACE_H
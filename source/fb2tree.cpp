@@ -12,6 +12,7 @@
 
 #include "fb2page.hpp"
 #include "fb2text.hpp"
+#include "fb2trace.h"
 #include "fb2html.h"
 #include "fb2utils.h"
 
@@ -19,11 +20,12 @@
 //  FbTreeItem
 //---------------------------------------------------------------------------
 
-FbTreeItem::FbTreeItem(QWebElement &element, FbTreeItem *parent, int number)
-    : QObject(parent)
-    , m_element(element)
+FbTreeItem::FbTreeItem(QWebElement &element, FbTreeItem *parent, int id)
+    : m_element(element)
     , m_parent(parent)
-    , m_number(number)
+    , m_id(id)
+    , m_fetched(false)
+    , m_branch(true)
 {
     init();
 }
@@ -37,26 +39,44 @@ FbTreeItem::~FbTreeItem()
 
 void FbTreeItem::init()
 {
-    m_text = QString();
+    m_cached = false;
     m_name = m_element.tagName().toLower();
     if (m_name.left(3) == "fb:") m_name = m_name.mid(3);
-    if (m_name == "title") {
-        m_text = title();
-        if (m_parent) m_parent->m_text += m_text += " ";
-    } else if (m_name == "subtitle") {
-        m_text = title();
-    } else if (m_name == "body") {
+    if (m_name == "body") {
         m_body = m_element.attribute("name");
     } else if (m_name == "img") {
         m_name = "image";
-        QUrl url = m_element.attribute("src");
-        m_text = url.fragment();
     }
 }
 
-QString FbTreeItem::title()
+QString FbTreeItem::title(const QWebElement &element)
 {
-    return m_element.toPlainText().left(255).simplified();
+    return element.toPlainText().left(255).simplified();
+}
+
+const QString & FbTreeItem::caption() const
+{
+    if (m_cached) return m_text;
+    m_cached = true;
+    m_text = QString();
+    if (m_name == "title") {
+        m_text = title(m_element) + " ";
+    } else if (m_name == "subtitle") {
+        m_text = title(m_element);
+    } else if (m_name == "image") {
+        QUrl url = m_element.attribute("src");
+        m_text = url.fragment();
+    } else if (m_fetched) {
+        foreach (FbTreeItem * child, m_list) {
+            if (child->m_name == "title") m_text += child->caption();
+        }
+    } else {
+        QWebElement child = m_element.firstChild();
+        for (; !child.isNull(); child = child.nextSibling()) {
+            if (child.tagName() == "FB:TITLE") m_text += title(child) + " ";
+        }
+    }
+    return m_text;
 }
 
 FbTreeItem * FbTreeItem::item(const QModelIndex &index) const
@@ -76,41 +96,7 @@ QString FbTreeItem::text() const
 {
     QString name = m_name;
     if (!m_body.isEmpty()) name += " name=" + m_body;
-    return QString("<%1> %2").arg(name).arg(m_text);
-}
-
-QString FbTreeItem::selector() const
-{
-    QString text = "";
-    QString selector = ".get(0)";
-    QWebElement element = m_element;
-    QWebElement parent = element.parent();
-    while (!parent.isNull()) {
-        text.prepend(element.tagName()).prepend("/");
-        QWebElement child = parent.firstChild();
-        int index = -1;
-        while (!child.isNull()) {
-            index++;
-            if (child == element) break;
-            child = child.nextSibling();
-        }
-        if (index == -1) return QString();
-        selector.prepend(QString(".children().eq(%1)").arg(index));
-        element = parent;
-        parent = element.parent();
-    }
-    return selector.prepend("$('html')");
-}
-
-FbTreeItem * FbTreeItem::content(int number) const
-{
-    FbTextElement element = m_element.firstChild();
-    while (number-- > 0) element = element.nextSibling();
-    FbTreeList::const_iterator it;
-    for (it = m_list.constBegin(); it != m_list.constEnd(); it++) {
-        if ((*it)->element() == element) return *it;
-    }
-    return 0;
+    return QString("<%1> %2").arg(name).arg(caption());
 }
 
 //---------------------------------------------------------------------------
@@ -122,10 +108,7 @@ FbTreeModel::FbTreeModel(FbTextEdit &view, QObject *parent)
     , m_view(view)
     , m_root(NULL)
 {
-    QWebElement doc = view.page()->mainFrame()->documentElement();
-    QWebElement body = doc.findFirst("body");
-    if (body.isNull()) return;
-    m_root = new FbTreeItem(body);
+    connect(view.page(), SIGNAL(marked(int)), SLOT(mark(int)));
 }
 
 FbTreeModel::~FbTreeModel()
@@ -192,9 +175,29 @@ int FbTreeModel::rowCount(const QModelIndex &parent) const
 
 QVariant FbTreeModel::data(const QModelIndex &index, int role) const
 {
-    if (role != Qt::DisplayRole) return QVariant();
     FbTreeItem * i = item(index);
-    return i ? i->text() : QVariant();
+    if (!i) return QVariant();
+    switch (role) {
+        case Qt::DisplayRole: {
+            return i->text();
+        } break;
+        case Qt::DecorationRole: {
+            if (!m_view.page()->violations(i->id()).isEmpty()) return FbIcon("dialog-warning");
+        } break;
+        case Qt::ToolTipRole: {
+            QString text = m_view.page()->violations(i->id());
+            if (!text.isEmpty()) return text;
+        } break;
+    }
+    return QVariant();
+}
+
+void FbTreeModel::mark(int id)
+{
+    if (FbTreeItem * i = m_index.value(id)) {
+        QModelIndex index = this->index(i);
+        if (index.isValid()) emit dataChanged(index, index);
+    }
 }
 
 void FbTreeModel::selectText(const QModelIndex &index)
@@ -204,21 +207,41 @@ void FbTreeModel::selectText(const QModelIndex &index)
     }
 }
 
-QModelIndex FbTreeModel::index(const QString &location) const
+QModelIndex FbTreeModel::index(const QList<int> &path)
 {
-    QModelIndex result;
-    FbTreeItem * parent = m_root;
-    QStringList list = location.split(",");
-    QStringListIterator iterator(list);
-    while (parent && iterator.hasNext()) {
-        QString str = iterator.next();
-        if (str.left(5) == "HTML=") continue;
-        int key = str.mid(str.indexOf("=")+1).toInt();
-        FbTreeItem * child = parent->content(key);
-        if (child) result = index(child);
-        parent = child;
+    FbTreeItem * result = NULL;
+    for (int i = path.count() - 1; i >= 0; i--) {
+        FbTreeItem * item = m_index.value(path[i]);
+        if (!item && result && !result->fetched()) {
+            fetch(*result);
+            item = m_index.value(path[i]);
+        }
+        if (item && item != m_root) result = item;
     }
-    return result;
+    return result ? index(result) : QModelIndex();
+}
+
+bool FbTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    FbTreeItem *owner = item(parent);
+    return owner ? !owner->fetched() : false;
+}
+
+void FbTreeModel::fetchMore(const QModelIndex &parent)
+{
+    FbTreeItem *owner = item(parent);
+    if (owner && !owner->fetched()) fetch(*owner);
+}
+
+void FbTreeModel::insert(FbTreeItem *item)
+{
+    if (item->id()) m_index.insert(item->id(), item);
+}
+
+void FbTreeModel::remove(FbTreeItem *item)
+{
+    if (m_index.value(item->id()) == item) m_index.remove(item->id());
+    for (int i = 0; i < item->count(); i++) remove(item->item(i));
 }
 
 QModelIndex FbTreeModel::move(const QModelIndex &index, int dx, int dy)
@@ -257,6 +280,7 @@ QModelIndex FbTreeModel::move(const QModelIndex &index, int dx, int dy)
             FbTreeItem * brother = owner->item(from - 1);
             if (!child->element().isSection()) return QModelIndex();
             if (!brother->element().isSection()) return QModelIndex();
+            if (!brother->fetched()) fetch(*brother);
 
             QModelIndex target = createIndex(from - 1, 0, (void*)brother);
             int to = rowCount(target);
@@ -311,6 +335,7 @@ bool FbTreeModel::removeRows(int row, int count, const QModelIndex &parent)
         if (FbTreeItem * child = owner->takeAt(i)) {
             QUndoCommand * command = new FbDeleteCmd(child->element());
             m_view.page()->push(command, "Delete element");
+            remove(child);
             delete child;
         }
     }
@@ -318,42 +343,91 @@ bool FbTreeModel::removeRows(int row, int count, const QModelIndex &parent)
     return true;
 }
 
+void FbTreeModel::build()
+{
+    QWebElement doc = m_view.page()->mainFrame()->documentElement();
+    QWebElement body = doc.findFirst("body");
+
+    beginResetModel();
+    if (m_root) delete m_root;
+    m_root = NULL;
+    m_index.clear();
+    if (!body.isNull()) {
+        m_root = new FbTreeItem(body, 0, FbTextElement(body).nodeId());
+        insert(m_root);
+    }
+    endResetModel();
+
+    if (m_root) fetch(*m_root);
+}
+
+// Children of evicted sections are parked in their stub, fbChildren() hands them over too
+FbTreeList FbTreeModel::children(FbTreeItem &owner)
+{
+    FbTextNodes &nodes = m_view.page()->nodes();
+    nodes.takeAll();
+    FB2_TRACE("js:fbChildren");
+    QString result = owner.element().evaluateJavaScript("fbChildren(this,true)").toString();
+    QStringList ids = result.split(",", QString::SkipEmptyParts);
+    QList<QWebElement> list = nodes.takeAll();
+
+    FbTreeList items;
+    for (int i = 0; i < list.count() && i < ids.count(); i++) {
+        FbTreeItem * child = new FbTreeItem(list[i]);
+        child->setId(ids[i].section(':', 0, 0).toInt());
+        child->setBranch(ids[i].section(':', 1) != "0");
+        items << child;
+    }
+    return items;
+}
+
+void FbTreeModel::fetch(FbTreeItem &owner)
+{
+    owner.setFetched(true);
+    FbTreeList list = children(owner);
+    if (list.isEmpty()) return;
+
+    beginInsertRows(index(&owner), 0, list.count() - 1);
+    foreach (FbTreeItem * child, list) {
+        owner.insert(child, owner.count());
+        insert(child);
+    }
+    endInsertRows();
+}
+
 void FbTreeModel::update(FbTreeItem &owner)
 {
     owner.init();
-    FbElementList list;
-    owner.element().getChildren(list);
+    QModelIndex index = this->index(&owner);
+
+    if (!owner.fetched()) {
+        owner.setBranch(owner.element().evaluateJavaScript("fbBranch(this)").toBool());
+        if (index.isValid()) emit dataChanged(index, index);
+        return;
+    }
 
     int pos = 0;
-    QModelIndex index = this->index(&owner);
-    for (FbElementList::iterator it = list.begin(); it != list.end(); it++) {
-        FbTreeItem * child = 0;
-        QWebElement element = *it;
-        int count = owner.count();
-        for (int i = pos; i < count; i++) {
-            if (owner.item(i)->element() == element) {
-                child = owner.item(i);
-                if (i > pos) {
-                    beginMoveRows(index, i, i, index, pos);
-                    owner.insert(owner.takeAt(i), pos);
-                    endMoveRows();
-                    break;
-                }
+    foreach (FbTreeItem * item, children(owner)) {
+        FbTreeItem * child = m_index.value(item->id());
+        if (child && child->parent() == &owner && child->element() == item->element()) {
+            if (!child->fetched()) child->setBranch(item->branch());
+            delete item;
+            int i = owner.index(child);
+            if (i > pos) {
+                beginMoveRows(index, i, i, index, pos);
+                owner.insert(owner.takeAt(i), pos);
+                endMoveRows();
             }
-        }
-        if (child) {
-            QString old = child->text();
-            update(*child);
-            if (old != child->text()) {
+            if (child->name() == "title" || child->name() == "image") {
+                child->init();
                 QModelIndex i = this->index(child);
                 emit dataChanged(i, i);
             }
         } else {
-            FbTreeItem * child = new FbTreeItem(element);
             beginInsertRows(index, pos, pos);
-            owner.insert(child, pos);
+            owner.insert(item, pos);
+            insert(item);
             endInsertRows();
-            update(*child);
         }
         pos++;
     }
@@ -361,23 +435,35 @@ void FbTreeModel::update(FbTreeItem &owner)
     int last = owner.count() - 1;
     if (pos <= last) {
         beginRemoveRows(index, pos, last);
-        for (int i = last; i >= pos; i--) delete owner.takeAt(i);
+        for (int i = last; i >= pos; i--) {
+            FbTreeItem * child = owner.takeAt(i);
+            remove(child);
+            delete child;
+        }
         endRemoveRows();
     }
+
+    if (index.isValid()) {
+        emit dataChanged(index, index);
+    }
 }
 
 void FbTreeModel::update()
 {
-    QWebElement doc = m_view.page()->mainFrame()->documentElement();
-    QWebElement body = doc.findFirst("body");
-    if (m_root) {
-        if (m_root->element() != body) *m_root = body;
-        update(*m_root);
-    } else {
-        if (!body.isNull()) {
-            m_root = new FbTreeItem(body);
-            update(*m_root);
-        }
+    FB2_TRACE("FbTreeModel::update");
+    QWebFrame *frame = m_view.page()->mainFrame();
+    QWebElement body = frame->documentElement().findFirst("body");
+    if (!m_root || m_root->element() != body) {
+        frame->evaluateJavaScript("fbDirty()");
+        build();
+        return;
+    }
+
+    QString dirty = frame->evaluateJavaScript("fbDirty()").toString();
+    foreach (const QString &id, dirty.split(",", QString::SkipEmptyParts)) {
+        FbTreeItem * item = m_index.value(id.toInt());
+        if (item && item->name() == "title" && item->parent()) item = item->parent();
+        if (item) update(*item);
     }
 }
 
@@ -386,14 +472,21 @@ QModelIndex FbTreeModel::append(const QModelIndex &parent, FbTextElement element
     FbTreeItem * owner = item(parent);
     if (!owner || owner == m_root) return QModelIndex();
 
+    if (!owner->fetched()) {
+        fetch(*owner);
+        FbTreeItem * child = m_index.value(element.nodeId());
+        return child ? index(child) : QModelIndex();
+    }
+
     int count = owner->count();
     int row = element.childIndex();
     if (row > count) row = count;
     if (row < 0) row = 0;
 
-    FbTreeItem * child = new FbTreeItem(element);
+    FbTreeItem * child = new FbTreeItem(element, 0, element.nodeId());
     beginInsertRows(parent, row, row);
     owner->insert(child, row);
+    insert(child);
     endInsertRows();
 
     return createIndex(row, 0, (void*)child);
@@ -420,7 +513,7 @@ FbTreeView::FbTreeView(FbTextEdit &view, QWidget *parent)
     m_timerSelect.setSingleShot(true);
     connect(&m_timerSelect, SIGNAL(timeout()), SLOT(selectTree()));
 
-    m_timerUpdate.setInterval(1000);
+    m_timerUpdate.setInterval(250);
     m_timerUpdate.setSingleShot(true);
     connect(&m_timerUpdate, SIGNAL(timeout()), SLOT(updateTree()));
 
@@ -628,8 +721,7 @@ void FbTreeView::selectTree()
 {
     if (qApp->focusWidget() == this) return;
     if (FbTreeModel * m = model()) {
-        QString location = m->view().page()->location();
-        QModelIndex index = m->index(location);
+        QModelIndex index = m->index(m->view().page()->nodePath());
         if (!index.isValid()) return;
         setCurrentIndex(index);
         scrollTo(index);
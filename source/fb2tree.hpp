@@ -2,7 +2,9 @@
 #define FB2TREE_H
 
 #include <QAbstractItemModel>
+#include <QHash>
 #include <QMenu>
+#include <QStringList>
 #include <QTreeView>
 #include <QTimer>
 #include <QToolBar>
@@ -21,24 +23,17 @@ class FbTreeModel;
 
 typedef QList<FbTreeItem*> FbTreeList;
 
-class FbTreeItem: public QObject
+class FbTreeItem
 {
-    Q_OBJECT
-
 public:
-    explicit FbTreeItem(QWebElement &element, FbTreeItem *parent = 0, int index = 0);
+    explicit FbTreeItem(QWebElement &element, FbTreeItem *parent = 0, int id = 0);
 
-    virtual ~FbTreeItem();
+    ~FbTreeItem();
 
     FbTreeItem * item(const QModelIndex &index) const;
 
     FbTreeItem * item(int row) const;
 
-    FbTreeItem & operator=(const QWebElement &element) {
-        m_element = element;
-        return *this;
-    }
-
     int index(FbTreeItem * child) const {
         return m_list.indexOf(child);
     }
@@ -52,8 +47,24 @@ public:
         return m_list.takeAt(row);
     }
 
-    bool hasChildren() {
-        return m_list.size();
+    bool hasChildren() const {
+        return m_fetched ? m_list.size() : m_branch;
+    }
+
+    bool fetched() const {
+        return m_fetched;
+    }
+
+    void setFetched(bool fetched) {
+        m_fetched = fetched;
+    }
+
+    bool branch() const {
+        return m_branch;
+    }
+
+    void setBranch(bool branch) {
+        m_branch = branch;
     }
 
     int count() const {
@@ -72,29 +83,37 @@ public:
         return m_name;
     }
 
-    QPoint pos() const {
-        return m_element.geometry().topLeft();
+    int id() const {
+        return m_id;
     }
 
-    FbTreeItem * content(int number) const;
+    void setId(int id) {
+        m_id = id;
+    }
 
-    QString selector() const;
+    QPoint pos() const {
+        return m_element.geometry().topLeft();
+    }
 
     QString text() const;
 
     void init();
 
 private:
-    QString title();
+    static QString title(const QWebElement &element);
+    const QString & caption() const;
 
 private:
     FbTreeList m_list;
     QWebElement m_element;
     QString m_name;
-    QString m_text;
+    mutable QString m_text;
+    mutable bool m_cached;
     QString m_body;
     FbTreeItem * m_parent;
-    int m_number;
+    int m_id;
+    bool m_fetched;
+    bool m_branch;
 };
 
 class FbTreeModel: public QAbstractItemModel
@@ -105,7 +124,7 @@ public:
     explicit FbTreeModel(FbTextEdit &view, QObject *parent = 0);
     virtual ~FbTreeModel();
     QModelIndex index(FbTreeItem *item, int column = 0) const;
-    QModelIndex index(const QString &location) const;
+    QModelIndex index(const QList<int> &path);
     FbTextEdit & view() { return m_view; }
     void selectText(const QModelIndex &index);
     QModelIndex move(const QModelIndex &index, int dx, int dy);
@@ -113,6 +132,9 @@ public:
     FbTreeItem * item(const QModelIndex &index) const;
     void update();
 
+public slots:
+    void mark(int id);
+
 public:
     virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
     virtual QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
@@ -121,13 +143,21 @@ public:
     virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
     virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     virtual bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+    virtual void fetchMore(const QModelIndex &parent);
 
 private:
+    void build();
+    void fetch(FbTreeItem &owner);
+    FbTreeList children(FbTreeItem &owner);
     void update(FbTreeItem &item);
+    void insert(FbTreeItem *item);
+    void remove(FbTreeItem *item);
 
 private:
     FbTextEdit & m_view;
     FbTreeItem * m_root;
+    QHash<int, FbTreeItem*> m_index;
 };
 
 class FbTreeView : public QTreeView
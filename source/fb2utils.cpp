@@ -40,3 +40,30 @@ QString jScript(const QString &filename)
 
     return in.readAll();
 }
+
+// The result is both a JavaScript and a JSON string literal
+QString jsString(const QString &text)
+{
+    QString result;
+    result.reserve(text.size() + 2);
+    result += '"';
+    for (int i = 0; i < text.size(); i++) {
+        const QChar c = text.at(i);
+        switch (c.unicode()) {
+            case '"'   : result += "\\\""; break;
+            case '\\'  : result += "\\\\"; break;
+            case '\n'  : result += "\\n"; break;
+            case '\r'  : result += "\\r"; break;
+            case 0x2028: result += "\\u2028"; break;
+            case 0x2029: result += "\\u2029"; break;
+            default:
+                if (c.unicode() < 0x20) {
+                    result += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+                } else {
+                    result += c;
+                }
+        }
+    }
+    result += '"';
+    return result;
+}
@@ -14,4 +14,6 @@ public:
 
 QString jScript(const QString &filename);
 
+QString jsString(const QString &text);
+
 #endif // FB2UTILS_H
@@ -0,0 +1,107 @@
+var fbScheme = null;
+
+var fbCheckDirty = {};
+
+var fbCheckFailed = {};
+
+function fbSchemeInit(tags, ranges, rules){
+var index = {};
+for (var i = 0; i < tags.length; i++) index[tags[i]] = i;
+var table = {};
+for (var name in ranges) {
+ var offset = ranges[name][0], count = ranges[name][1];
+ var slots = [];
+ for (var t = 0; t < tags.length; t++) slots.push(-1);
+ for (var s = 0; s < count; s++) slots[rules[(offset + s) * 3]] = s;
+ table[name] = { offset: offset, count: count, slots: slots };
+}
+fbScheme = { tags: tags, index: index, table: table, rules: rules };
+};
+
+function fbCheckName(tag){
+tag = tag.toLowerCase();
+if (tag === "img") return "image";
+return tag.substr(0, 3) === "fb:" ? tag.substr(3) : tag;
+};
+
+function fbCheckNode(node){
+var entry = fbScheme.table[node.tagName];
+if (!entry) return "";
+var counts = [];
+for (var s = 0; s < entry.count; s++) counts.push(0);
+var errors = [];
+var last = 0;
+var f = function(parent){
+ for (var n = parent.firstChild; n; n = n.nextSibling) {
+  if (n.nodeType !== 1) continue;
+  if (n.fbContent) { f(n.fbContent); continue; }
+  var t = fbScheme.index[n.tagName];
+  if (t === undefined) continue;
+  var s = entry.slots[t];
+  if (s < 0) continue;
+  counts[s]++;
+  if (s >= last) last = s;
+  else errors.push("misplaced <" + fbCheckName(n.tagName) + ">");
+ }
+};
+f(node);
+for (var s = 0; s < entry.count; s++) {
+ var r = (entry.offset + s) * 3;
+ var tag = fbCheckName(fbScheme.tags[fbScheme.rules[r]]);
+ var min = fbScheme.rules[r + 1], max = fbScheme.rules[r + 2];
+ if (counts[s] < min) errors.push("missing <" + tag + ">");
+ if (max && counts[s] > max) errors.push("too many <" + tag + ">");
+}
+if (!errors.length) return "";
+var label = "<" + fbCheckName(node.tagName) + ">";
+for (var n = node.firstChild; n; n = n.nextSibling) {
+ if (n.nodeType !== 1 || n.tagName !== "FB:TITLE") continue;
+ var title = n.textContent.replace(/\s+/g, " ").replace(/^ | $/g, "");
+ if (title.length > 40) title = title.substr(0, 40) + "...";
+ if (title) label += " \"" + title + "\"";
+ break;
+}
+return label + ": " + errors.join(", ");
+};
+
+function fbCheck(all){
+if (!fbScheme) return [];
+var list = [];
+var nodes = [];
+if (all) {
+ var names = [];
+ for (var name in fbScheme.table) {
+  if (name !== "BODY") names.push(name.replace(":", "\\:"));
+ }
+ names.push("div.fb-stub");
+ var query = names.join(",");
+ // Evicted sections are checked in their detached fragments
+ var collect = function(root){
+  var found = root.querySelectorAll(query);
+  for (var i = 0; i < found.length; i++) {
+   if (found[i].fbContent) collect(found[i].fbContent); else nodes.push(found[i]);
+  }
+ };
+ nodes.push(document.body);
+ collect(document.body);
+ fbCheckFailed = {};
+} else {
+ for (var id in fbCheckDirty) nodes.push(fbNodes[id]);
+ for (var id in fbCheckFailed) {
+  var node = fbNodes[id];
+  if (node && fbAttached(node)) continue;
+  delete fbCheckFailed[id];
+  list.push(+id, "");
+ }
+}
+fbCheckDirty = {};
+for (var i = 0; i < nodes.length; i++) {
+ var node = nodes[i];
+ if (!node) continue;
+ var text = fbAttached(node) ? fbCheckNode(node) : "";
+ var id = fbId(node);
+ if (text) fbCheckFailed[id] = true; else delete fbCheckFailed[id];
+ if (text || !all) list.push(id, text);
+}
+return list;
+};
@@ -1,4 +1,4 @@
-(function(root) {
+function fbExport(root) {
     var selection = document.getSelection();
     var anchorNode = selection.anchorNode;
     var focusNode = selection.focusNode;
@@ -21,4 +21,4 @@
     handler.onNew(root.nodeName);
     for (var n = root.firstChild; n !== null; n = n.nextSibling) f(n);
     handler.onEnd(root.nodeName);
-})(document);
+}
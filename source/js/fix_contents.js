@@ -0,0 +1,32 @@
+(function(){
+var queue = [];
+var busy = false;
+var frame = function(f){
+ if (window.webkitRequestAnimationFrame) return window.webkitRequestAnimationFrame(f);
+ return setTimeout(f, 16);
+};
+var scrub = function(){
+ busy = true;
+ for (var i = 0; i < queue.length; i++) {
+  var node = queue[i];
+  node.fbQueued = false;
+  if (node.hasAttribute("style")) node.removeAttribute("style");
+  var list = node.querySelectorAll("[style]");
+  for (var j = 0; j < list.length; j++) list[j].removeAttribute("style");
+ }
+ queue = [];
+ busy = false;
+};
+var touch = function(e){
+ if (busy || fbMuted) return;
+ var node = e.target;
+ if (node.nodeType !== 1) node = node.parentNode;
+ if (!node || node.nodeType !== 1) return;
+ if (node.fbQueued) return;
+ node.fbQueued = true;
+ if (queue.push(node) === 1) frame(scrub);
+};
+document.addEventListener("DOMContentLoaded", function(){
+ document.body.addEventListener("DOMSubtreeModified", touch, true);
+}, false);
+})();
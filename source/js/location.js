@@ -1,13 +1,182 @@
-function location(e){
-$.fn.reverse = [].reverse;
-var h=$(e).parents().reverse().add($(e));
-var f=function(){
- var p=$(this).parent();
- var t=p.get(0).tagName;
- if(t===undefined)return;
- return t+"="+p.children().index(this);
-};
-return h.map(f).get().join(",");
+var fbGeneration = 0;
+
+var fbDirtyIds = {};
+
+var fbMuted = false;
+
+document.addEventListener("DOMContentLoaded", function(){
+ document.body.addEventListener("DOMSubtreeModified", function(e){
+  if (fbMuted) return;
+  fbGeneration++;
+  for (var n = e.target; n; n = n.parentNode) {
+   if (n.nodeType !== 1) continue;
+   if (n.tagName === "BODY" || n.tagName.substr(0, 3) === "FB:") {
+    fbDirtyIds[fbId(n)] = true;
+    fbCheckDirty[fbId(n)] = true;
+    break;
+   }
+  }
+ }, true);
+ document.body.addEventListener("DOMNodeRemoved", function(){
+  if (fbMuted || fbSweepTimer) return;
+  fbSweepTimer = setTimeout(fbSweep, 1000);
+ }, true);
+}, false);
+
+var fbNextId = 0;
+
+var fbNodes = {};
+
+var fbSweepTimer = 0;
+
+function fbId(node){
+if (!node) return 0;
+if (!node.fbId) node.fbId = ++fbNextId;
+// A node put back by undo registers again under its old id
+fbNodes[node.fbId] = node;
+return node.fbId;
+};
+
+// Drop removed nodes from the map so deleted content can be collected
+function fbSweep(){
+fbSweepTimer = 0;
+for (var id in fbNodes) {
+ var node = fbNodes[id];
+ if (window.fbAttached ? !fbAttached(node) : !document.body.contains(node)) delete fbNodes[id];
+}
+};
+
+function fbParagraphs(){
+var list = [];
+var nodes = document.body.querySelectorAll("p,div.fb-stub");
+for (var i = 0; i < nodes.length; i++) {
+ var n = nodes[i], p = n.parentNode;
+ if (n.fbContent) {
+  var hidden = n.fbContent.getElementsByTagName("P");
+  for (var j = 0; j < hidden.length; j++) list.push(fbId(hidden[j]), hidden[j].textContent);
+  continue;
+ }
+ while (p && p.tagName !== "FB:DESCRIPTION") p = p.parentNode;
+ if (!p) list.push(fbId(n), n.textContent);
+}
+return list;
+};
+
+// Sum text node lengths without building the textContent string
+function fbTextLength(root){
+var length = 0;
+var walker = document.createTreeWalker(root, NodeFilter.SHOW_TEXT, null, false);
+while (walker.nextNode()) length += walker.currentNode.length;
+return length;
+};
+
+function fbMemory(){
+var result = { elements: 0, chars: 0, hidden: 0, hiddenChars: 0, pixels: 0, images: [] };
+result.elements = document.getElementsByTagName("*").length;
+result.chars = fbTextLength(document.body);
+var stubs = document.body.querySelectorAll("div.fb-stub");
+for (var i = 0; i < stubs.length; i++) {
+ var content = stubs[i].fbContent;
+ if (!content) continue;
+ result.hidden += content.getElementsByTagName("*").length;
+ result.hiddenChars += fbTextLength(content);
+}
+var images = document.images;
+for (var i = 0; i < images.length; i++) {
+ var img = images[i];
+ if (!img.complete || !img.naturalWidth) continue;
+ var src = img.getAttribute("src") || "";
+ result.pixels += img.naturalWidth * img.naturalHeight;
+ result.images.push(src.substr(src.indexOf("#") + 1));
+}
+return result;
+};
+
+function fbSelect(id){
+var node = fbNodes[id];
+if (!node) return false;
+if (!fbReveal(node)) {
+ delete fbNodes[id];
+ return false;
+}
+node.scrollIntoView(false);
+window.getSelection().collapse(node, 0);
+return true;
+};
+
+function fbCurrent(){
+var node = document.getSelection().anchorNode;
+while (node && node.nodeType !== 1) node = node.parentNode;
+return node ? fbId(node) : 0;
+};
+
+function fbElement(id){
+var node = fbNodes[id];
+if (!node) return false;
+if (!document.documentElement.contains(node) && !(window.fbReveal && fbReveal(node))) return false;
+fbNodeBridge.hand(node);
+return true;
+};
+
+function fbPath(node){
+var list = [];
+for (; node && node.tagName !== "BODY"; node = node.parentNode) {
+ if (node.nodeType === 1) list.push(fbId(node));
+}
+return list.join(",");
+};
+
+function fbDirty(){
+var list = [];
+for (var id in fbDirtyIds) list.push(id);
+fbDirtyIds = {};
+return list.join(",");
+};
+
+function fbBranch(node){
+for (var n = node.firstChild; n; n = n.nextSibling) {
+ if (n.nodeType !== 1) continue;
+ var tag = n.tagName;
+ if (tag === "FB:DESCRIPTION") continue;
+ if (tag === "IMG" || tag.substr(0, 3) === "FB:") return true;
+ if (fbBranch(n.fbContent || n)) return true;
+}
+return false;
+};
+
+// With hand set, each child also goes to fbNodeBridge in the same order
+function fbChildren(root, hand){
+var list = [];
+var f = function(node){
+ for (var n = node.firstChild; n; n = n.nextSibling) {
+  if (n.nodeType !== 1) continue;
+  var tag = n.tagName;
+  if (tag === "FB:DESCRIPTION") continue;
+  if (tag === "IMG" || tag.substr(0, 3) === "FB:") {
+   list.push(fbId(n) + ":" + (fbBranch(n) ? 1 : 0));
+   if (hand) fbNodeBridge.hand(n);
+  } else f(n.fbContent || n);
+ }
+};
+f(root);
+return list.join(",");
+};
+
+function status(){
+var node = document.getSelection().baseNode;
+if (!node) return "";
+var f = function(node){
+ if (!node || node.nodeType !== 1) return "";
+ var tag = node.tagName;
+ if (tag === "BODY") return "";
+ if (node.fbStatusGeneration === fbGeneration) return node.fbStatus;
+ if (tag === "DIV") tag = node.getAttribute("CLASS");
+ var result = f(node.parentNode) + "/" + tag;
+ node.fbStatusGeneration = fbGeneration;
+ node.fbStatus = result;
+ return result;
+};
+return f(node.parentNode);
 };
 
 function locator(node){
@@ -0,0 +1,95 @@
+var fbNotesRevision = 0;
+
+var fbNotesDirty = {};
+
+var fbNotesNodes = {};
+
+function fbNotesChanged(){
+var list = [];
+for (var id in fbNotesDirty) list.push(id);
+fbNotesDirty = {};
+return list.join(",");
+};
+
+function fbNotesEntry(list, n, attached){
+if (n.tagName === "A") {
+ list.push(fbId(n), "a", attached, n.getAttribute("href") || "", n.getAttribute("type") || "", n.textContent);
+} else {
+ list.push(fbId(n), "section", attached, n.getAttribute("id") || "", "", "");
+ fbNodeBridge.hand(n);
+}
+};
+
+function fbNotesIndex(){
+var list = [];
+fbNotesNodes = {};
+var f = function(root){
+ var nodes = root.querySelectorAll("fb\\:section[id],a,div.fb-stub");
+ for (var i = 0; i < nodes.length; i++) {
+  var n = nodes[i];
+  if (n.tagName !== "DIV") fbNotesEntry(list, n, true);
+  else if (n.fbContent) f(n.fbContent);
+ }
+};
+f(document.body);
+return list;
+};
+
+// Only the anchors and sections touched since the last call
+function fbNotesDelta(){
+var list = [];
+for (var id in fbNotesNodes) {
+ var n = fbNotesNodes[id];
+ fbNotesEntry(list, n, window.fbAttached ? fbAttached(n) : document.body.contains(n));
+}
+fbNotesNodes = {};
+return list;
+};
+
+(function(){
+var mark = function(node){
+ fbNotesNodes[fbId(node)] = node;
+};
+var check = function(node){
+ if (node.nodeType !== 1) return false;
+ var found = node.tagName === "A" || (node.tagName === "FB:SECTION" && node.hasAttribute("id"));
+ if (found) mark(node);
+ var list = node.querySelectorAll("fb\\:section[id],a");
+ for (var i = 0; i < list.length; i++) mark(list[i]);
+ return found || list.length > 0;
+};
+var touch = function(e){
+ if (fbMuted) return;
+ if (check(e.target)) fbNotesRevision++;
+};
+// QtWebKit sends no DOMAttrModified, an attribute change arrives as a subtree change of its element
+var key = function(node){
+ if (node.nodeType !== 1) return;
+ var name = node.tagName === "A" ? "href" : node.tagName === "FB:SECTION" ? "id" : null;
+ if (!name) return;
+ var value = node.getAttribute(name);
+ if (node.fbNoteKey === value) return;
+ node.fbNoteKey = value;
+ mark(node);
+ fbNotesRevision++;
+};
+document.addEventListener("DOMContentLoaded", function(){
+ var body = document.body;
+ body.addEventListener("DOMNodeInserted", touch, true);
+ body.addEventListener("DOMNodeRemoved", touch, true);
+ body.addEventListener("DOMSubtreeModified", function(e){
+  if (fbMuted) return;
+  key(e.target);
+  for (var n = e.target; n; n = n.parentNode) {
+   if (n.nodeType !== 1) continue;
+   if (n.tagName === "FB:SECTION" && n.hasAttribute("id")) {
+    fbNotesDirty[n.getAttribute("id")] = true;
+   } else if (n.tagName === "A") {
+    // The anchor text is listed in the notes dock
+    mark(n);
+    fbNotesRevision++;
+   }
+  }
+ }, true);
+}, false);
+})();
@@ -0,0 +1,43 @@
+var fbBatch = [];
+
+var fbEdits = [];
+
+function fbTexts(ids){
+fbBatch = [];
+var list = [];
+for (var i = 0; i < ids.length; i++) {
+ var node = fbNodes[ids[i]];
+ if (!node || !fbAttached(node)) continue;
+ var walker = document.createTreeWalker(node, NodeFilter.SHOW_TEXT, null, false);
+ while (walker.nextNode()) {
+  fbBatch.push(walker.currentNode);
+  list.push(walker.currentNode.data);
+ }
+}
+return list;
+};
+
+function fbReplace(changes){
+var edit = { nodes: [], before: [], after: [] };
+for (var i = 0; i + 1 < changes.length; i += 2) {
+ var node = fbBatch[changes[i]];
+ edit.nodes.push(node);
+ edit.before.push(node.data);
+ edit.after.push(changes[i + 1]);
+ node.data = changes[i + 1];
+}
+fbBatch = [];
+fbEdits.push(edit);
+return fbEdits.length - 1;
+};
+
+function fbReplaceDrop(n){
+delete fbEdits[n];
+};
+
+function fbReplaceApply(n, redo){
+var edit = fbEdits[n];
+if (!edit) return;
+var data = redo ? edit.after : edit.before;
+for (var i = 0; i < edit.nodes.length; i++) edit.nodes[i].data = data[i];
+};
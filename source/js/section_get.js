@@ -1,4 +1,4 @@
-(f=function(){
+function fbSectionGet(){
 var selection=window.getSelection();
 if(selection.rangeCount===0)return;
 var range=selection.getRangeAt(0);
@@ -9,7 +9,7 @@ while (true) {
  if(root===null)return;
  tag=root.tagName;
  if(tag==="BODY")return;
- if(tag==="FB:BODY"||type==="FB:SECTION")break;
+ if(tag==="FB:BODY"||tag==="FB:SECTION")break;
  root = root.parentNode;
 }
 while(start.parentNode!==root) {
@@ -20,11 +20,11 @@ while(end.parentNode!==root) {
  if(end===null)return;
  end=end.parentNode;
 }
-return location(root)
+return fbId(root)
 +"|"+$(root).children().index(start)
 +","+$(root).children().index(end)
 +"|"+locator(range.startContainer)
 +","+range.startOffset
 +","+locator(range.endContainer)
 +","+range.endOffset;
-})()
+};
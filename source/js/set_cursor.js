@@ -1,9 +1,12 @@
-window.scrollTo(0,this.offsetTop);
+function fbSetCursor(node){
+if (window.fbReveal) fbReveal(node);
+window.scrollTo(0,node.offsetTop);
 var range = document.createRange();
-range.setStart(this,0);
-range.setEnd(this,0);
+range.setStart(node,0);
+range.setEnd(node,0);
 var selection = window.getSelection();
 selection.removeAllRanges();
 selection.addRange(range);
 range.collapse(true);
 range.select();
+};
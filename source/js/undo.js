@@ -0,0 +1,20 @@
+function fbAbsorb(node,count){
+while (count > 0) {
+ var next = node.nextSibling;
+ if (next === null) break;
+ if (next.nodeType === 1) count--;
+ node.appendChild(next);
+}
+};
+
+function fbRelease(node){
+var parent = node.parentNode;
+var count = 0;
+while (node.firstChild !== null) {
+ var child = node.firstChild;
+ if (child.nodeType === 1) count++;
+ parent.insertBefore(child, node);
+}
+parent.removeChild(node);
+return count;
+};
@@ -0,0 +1,146 @@
+var fbVirtualDepth = 0;
+
+var fbVirtualHidden = [];
+
+function fbVirtualSections(){
+var list = [];
+for (var b = document.body.firstChild; b; b = b.nextSibling) {
+ if (b.nodeType !== 1 || b.tagName !== "FB:BODY" || b.hasAttribute("name")) continue;
+ for (var n = b.firstChild; n; n = n.nextSibling) {
+  if (n.nodeType === 1 && n.tagName === "FB:SECTION") list.push(n);
+ }
+}
+return list;
+};
+
+function fbVirtualStubbed(section){
+var stub = section.fbStub;
+if (!stub) return false;
+if (stub.parentNode === section) return true;
+section.fbStub = null;
+return false;
+};
+
+function fbEvict(section, height){
+if (fbVirtualStubbed(section)) return;
+var start = section.firstChild;
+while (start && start.nodeType !== 1) start = start.nextSibling;
+if (start && start.tagName === "FB:TITLE") {
+ if (height === undefined) height = section.offsetHeight - start.offsetHeight;
+ start = start.nextSibling;
+} else if (height === undefined) height = section.offsetHeight;
+if (!start) return;
+var content = document.createElement("div");
+var stub = document.createElement("div");
+stub.className = "fb-stub";
+stub.setAttribute("contenteditable", "false");
+stub.style.height = Math.max(height, 1) + "px";
+stub.fbContent = content;
+content.fbStub = stub;
+fbMuted = true;
+section.insertBefore(stub, start);
+while (stub.nextSibling) content.appendChild(stub.nextSibling);
+fbMuted = false;
+section.fbStub = stub;
+};
+
+function fbMaterialize(section){
+if (!fbVirtualStubbed(section)) return;
+var stub = section.fbStub;
+var content = stub.fbContent;
+fbMuted = true;
+while (content.firstChild) section.insertBefore(content.firstChild, stub);
+section.removeChild(stub);
+fbMuted = false;
+section.fbStub = null;
+// The outline may have been built while the content was parked
+fbDirtyIds[fbId(section)] = true;
+};
+
+function fbReveal(node){
+for (var n = node; n; n = n.parentNode) {
+ if (!n.fbStub || n.tagName === "FB:SECTION") continue;
+ var section = n.fbStub.parentNode;
+ if (!section) return false;
+ fbMaterialize(section);
+ return fbReveal(section);
+}
+return document.body.contains(node);
+};
+
+function fbAttached(node){
+for (var n = node; n; n = n.parentNode) {
+ if (n.fbStub && n.tagName !== "FB:SECTION") return fbAttached(n.fbStub);
+}
+return document.body.contains(node);
+};
+
+function fbVirtualSuspend(){
+if (fbVirtualDepth++) return;
+var list = fbVirtualSections();
+for (var i = 0; i < list.length; i++) {
+ if (!fbVirtualStubbed(list[i])) continue;
+ fbVirtualHidden.push([list[i], list[i].fbStub.style.height]);
+ fbMaterialize(list[i]);
+}
+};
+
+function fbVirtualResume(){
+if (--fbVirtualDepth) return;
+for (var i = 0; i < fbVirtualHidden.length; i++) {
+ var section = fbVirtualHidden[i][0];
+ if (document.body.contains(section)) fbEvict(section, parseInt(fbVirtualHidden[i][1]));
+}
+fbVirtualHidden = [];
+};
+
+(function(){
+var enabled = false;
+var busy = false;
+var frame = function(f){
+ if (window.webkitRequestAnimationFrame) return window.webkitRequestAnimationFrame(f);
+ return setTimeout(f, 16);
+};
+// Rough guess until the section has been laid out at least once
+var estimate = function(section){
+ var width = Math.max(document.body.clientWidth, 320);
+ var chars = section.textContent.length;
+ var blocks = section.getElementsByTagName("P").length;
+ return Math.ceil(chars * 8 / width) * 20 + blocks * 16;
+};
+var update = function(){
+ busy = false;
+ if (fbVirtualDepth) return;
+ var height = window.innerHeight;
+ var list = fbVirtualSections();
+ for (var i = 0; i < list.length; i++) {
+  var section = list[i];
+  var rect = section.getBoundingClientRect();
+  var near = rect.bottom > -height && rect.top < height * 2;
+  if (near && fbVirtualStubbed(section)) {
+   var before = section.offsetHeight;
+   fbMaterialize(section);
+   if (rect.bottom < 0) window.scrollBy(0, section.offsetHeight - before);
+  } else if (!near && !fbVirtualStubbed(section)) {
+   var selection = window.getSelection();
+   if (selection.rangeCount && section.contains(selection.anchorNode)) continue;
+   fbEvict(section);
+  }
+ }
+};
+var schedule = function(){
+ if (!enabled || busy) return;
+ busy = true;
+ frame(update);
+};
+document.addEventListener("DOMContentLoaded", function(){
+ var limit = window.fbVirtualLimit || 0;
+ if (limit <= 0) return;
+ if (document.body.getElementsByTagName("P").length < limit) return;
+ enabled = true;
+ var list = fbVirtualSections();
+ for (var i = 1; i < list.length; i++) fbEvict(list[i], estimate(list[i]));
+ window.addEventListener("scroll", schedule, false);
+ window.addEventListener("resize", schedule, false);
+}, false);
+})();